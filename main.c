@@ -1,18 +1,26 @@
 #include <assert.h>
+#include <getopt.h>
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <time.h>
+#include <unistd.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 #include <SDL.h>
 
 #define GENE_COUNT 16
 #define CELL_SCARCITY 48
-#define FOOD_SCARCITY 11
 #define CLUMP_COUNT 30
-#define MUTATION_RATE 0.03
 #define CELL_START_SCORE 250
 #define FOOD_SCORE 250
-#define CELL_MITOSIS_THRESHOLD 1000
 #define FRAME_INTERVAL 0
 
 typedef enum {
@@ -29,24 +37,276 @@ typedef enum {
 
 FoodRebirth food_rebirth = FOOD_REBIRTH_SOMEWHERE;
 
+// Replaces food objects with a nutrient concentration on every square, which
+// regrows towards NUTRIENT_CAPACITY and diffuses to neighbouring squares each
+// tick. Cells harvest the whole units on a square when they move onto it.
+// Cells don't sense nutrients, so parking is unaffected.
+bool nutrient_field = false;
+
+#define NUTRIENT_CAPACITY 40.0f
+// fraction of the shortfall from capacity regrown per tick
+#define NUTRIENT_REGROWTH 0.002f
+// fraction of the difference from each neighbour exchanged per tick, at most
+// 0.25 so that the field stays within [0, NUTRIENT_CAPACITY]
+#define NUTRIENT_DIFFUSION 0.1f
+#define NUTRIENT_LANES 8
+// rows per parallel_for task of the diffusion stencil
+#define NUTRIENT_BAND_ROWS 16
+
+// Unaligned, as the stencil loads each row at offsets of one square.
+typedef float NutrientVec
+    __attribute__((vector_size(NUTRIENT_LANES * sizeof(float)), aligned(sizeof(float)), may_alias));
+
+// Row-major grids make north/south neighbours a whole row apart. The Morton
+// layout stores the grid as row-major TILE_SIZE square tiles, each in Z-order,
+// so that all four neighbours of a square usually share a cache line or two.
+typedef enum {
+    GRID_LAYOUT_ROW_MAJOR,
+    GRID_LAYOUT_MORTON,
+} GridLayout;
+
+GridLayout grid_layout = GRID_LAYOUT_ROW_MAJOR;
+
+static char const *const grid_layout_names[] = {
+    [GRID_LAYOUT_ROW_MAJOR] = "row-major",
+    [GRID_LAYOUT_MORTON] = "morton",
+};
+
+// Ticks between re-sorting the cell table into grid storage order, 0 to never
+// sort. Births and deaths scatter the table so that the sweep, which walks the
+// grid, would otherwise jump around the cell table.
+int cell_sort_interval = 64;
+
+// Cells ahead of the update that the sweep prefetches for, tune with --bench.
+#define PREFETCH_DISTANCE_MAX 64
+int prefetch_distance = 8;
+
+// Whether large world allocations try huge pages before normal ones.
+bool huge_pages = true;
+
+// Threads for parallel work, 0 for one per online CPU.
+int thread_count = 0;
+
+// Lazy worlds start with only the centre tile populated. The rest of each tile
+// is generated from the world seed and tile number the first time anything
+// looks at it, so startup is instant and memory follows the explored area.
+// Tiles are the chunks, so lazy worlds always use GRID_LAYOUT_MORTON.
+bool lazy_worlds = false;
+
+// Cells turning on the spot among neighbours that don't change repeat the
+// same few states until they starve. Such cells are parked: the sweep skips
+// them until a neighbouring square changes or their score runs out, and the
+// steps they missed are charged all at once, so runs come out the same as
+// without.
+bool park_cells = false;
+
+// Instead of sweeping the squares in order, every thread updates its share of
+// the cell table at once. A move claims its square with a compare and swap,
+// so a cell that loses a square to another stays put, and eaten food claims
+// its new square the same way. Neighbouring squares are read as they happen
+// to be, so runs aren't repeatable. Births lock the genome store, and cells
+// that run out of score are freed once the threads are done. Parking and
+// predation, which reach into other cells, and lazy worlds, whose tiles are
+// generated on first look, aren't supported.
+bool async_update = false;
+
+// How time passes for cells. With TIMING_TICK every cell acts once a tick
+// whatever its action costs. With TIMING_EVENT an action takes as long as it
+// costs, EVENT_TICK_COST to a tick, so cheap actions come round more often,
+// and cells are queued by when they act next, so a tick costs the cells due
+// in it rather than a sweep of the grid. Parking and asynchronous sweeps,
+// which decide themselves when cells act, and batches, which share one sweep
+// of the grid, aren't supported.
+typedef enum {
+    TIMING_TICK,
+    TIMING_EVENT,
+} Timing;
+
+Timing timing = TIMING_TICK;
+
+static char const *const timing_names[] = {
+    [TIMING_TICK] = "tick",
+    [TIMING_EVENT] = "event",
+};
+
+#define EVENT_TICK_COST 4
+// actions that cost more take this long, and those that cost nothing one unit
+#define EVENT_DURATION_MAX 256
+
+// Mating crosses an offspring's chromosome with a neighbour of its parent's
+// before mutation, either picking each gene from either at random or taking
+// the genes before a random point from the parent and the rest from the mate.
+typedef enum {
+    MATING_NONE,
+    MATING_UNIFORM,
+    MATING_ONE_POINT,
+} Mating;
+
+Mating mating = MATING_NONE;
+
+static char const *const mating_names[] = {
+    [MATING_NONE] = "none",
+    [MATING_UNIFORM] = "uniform",
+    [MATING_ONE_POINT] = "one-point",
+};
+
+// The generational mode, --ga, evaluates a population of chromosomes each
+// generation, each in its own arena world of the usual size and options where
+// every cell starts with that chromosome, and breeds the next from the score
+// the arena's cells ate over ga_ticks.
+int ga_population = 64;
+long ga_ticks = 500;
+
+// The tuning mode, --tune, searches Params by successive halving. It makes a
+// world of the usual size and options, all from the same seed, for each of a
+// number of random variations on the configured params, and runs them side by
+// side for tune_ticks. The better half by tune_objective over that round run
+// on for twice as many ticks, and so on until two are left.
+typedef enum {
+    // score eaten per tick
+    TUNE_OBJECTIVE_EATEN,
+    // mean cells alive
+    TUNE_OBJECTIVE_CELLS,
+    // mean live genomes
+    TUNE_OBJECTIVE_SPECIES,
+} TuneObjective;
+
+TuneObjective tune_objective = TUNE_OBJECTIVE_EATEN;
+
+static char const *const tune_objective_names[] = {
+    [TUNE_OBJECTIVE_EATEN] = "eaten",
+    [TUNE_OBJECTIVE_CELLS] = "cells",
+    [TUNE_OBJECTIVE_SPECIES] = "species",
+};
+
+long tune_ticks = 200;
+
+// --batch steps the worlds of --ga and --tune a Batch at a time over
+// interleaved grids, so that the sweep finds the squares holding a cell in any
+// world of the batch with one vector load. Cells themselves are still updated
+// one world at a time. The results are the same as without.
+bool batch_worlds = false;
+
+// What bench and interactive runs do when a world's cells fall below
+// population_floor: carry on sweeping, restock it with cells started from the
+// hall of fame or chromosome_root, or stop with EXIT_EXTINCT.
+typedef enum {
+    EXTINCTION_IGNORE,
+    EXTINCTION_RESEED,
+    EXTINCTION_EXIT,
+} Extinction;
+
+Extinction extinction = EXTINCTION_IGNORE;
+
+static char const *const extinction_names[] = {
+    [EXTINCTION_IGNORE] = "ignore",
+    [EXTINCTION_RESEED] = "reseed",
+    [EXTINCTION_EXIT] = "exit",
+};
+
+int population_floor = 1;
+
+#define EXIT_EXTINCT 3
+
+// Bench runs stop early once any of these is met, each 0 to never: the moving
+// averages of the cell count and of the score eaten per tick both vary by no
+// more than converge_cv of themselves over about CONVERGE_WINDOW ticks, the
+// most populous species has stayed the same for stable_ticks, or time_limit
+// seconds have passed. They also stop if the population dies out.
+double converge_cv = 0;
+long stable_ticks = 0;
+double time_limit = 0;
+
+#define CONVERGE_WINDOW 256
+// ticks between looking for the most populous species
+#define DOMINANT_CHECK_INTERVAL 64
+
+#define TILE_SHIFT 6
+#define TILE_SIZE (1 << TILE_SHIFT)
+#define TILE_AREA (TILE_SIZE * TILE_SIZE)
+
+#define PARK_BLOCK_SHIFT 3
+#define PARK_BLOCK_SIZE (1 << PARK_BLOCK_SHIFT)
+
 typedef enum {
     ACTION_MOVE_FORWARD,
     ACTION_TURN_LEFT,
     ACTION_TURN_RIGHT,
     ACTION_MOVE_BACKWARD,
+    // takes up to ATTACK_SCORE from the faced cell
+    ACTION_ATTACK,
+    // adds PHEROMONE_DEPOSIT to the cell's square
+    ACTION_DEPOSIT,
     ACTION_MAX,
 } Action;
 
-static int const action_costs[ACTION_MAX] = {8, 3, 3, 5};
+// Tunables a world is made with, set from the command line or searched over
+// by --tune. Each world keeps its own copy, so tuning can run worlds with
+// different values side by side.
+typedef struct {
+    // chance of each response's action, and separately its next state, being
+    // replaced at random in an offspring
+    double mutation_rate;
+    // squares per food object
+    int food_scarcity;
+    // score at which a cell divides
+    int mitosis_threshold;
+    int action_costs[ACTION_MAX];
+} Params;
+
+Params params = {
+    .mutation_rate = 0.03,
+    .food_scarcity = 11,
+    .mitosis_threshold = 1000,
+    .action_costs = {8, 3, 3, 5, 5, 2},
+};
+
+#define ATTACK_SCORE 100
+
+// Whether mutation can produce ACTION_ATTACK. Without it cells can only
+// compete for food.
+bool predation = false;
+
+// Whether cells can deposit a trail that spreads and fades over the following
+// ticks, and see it on empty squares as SITUATION_TRAIL. The field is stepped
+// on its own thread while the cells are updated, see world_update_pheromones.
+bool pheromones = false;
+
+// The actions mutation can produce, those before ACTION_ATTACK and then the
+// optional ones in order.
+static inline int action_count(void)
+{
+    return ACTION_ATTACK + predation + pheromones;
+}
 
 typedef enum {
     SITUATION_EMPTY,
     SITUATION_FOOD,
     SITUATION_LIFE,
     SITUATION_WALL,
+    // an empty square with at least PHEROMONE_SENSE on it
+    SITUATION_TRAIL,
     SITUATION_MAX,
 } Situation;
 
+// The situations chromosomes respond to, so that without pheromones the
+// SITUATION_TRAIL responses stay zero and draw no random numbers.
+static inline int situation_count(void)
+{
+    return pheromones ? SITUATION_MAX : SITUATION_TRAIL;
+}
+
+// 16-bit fixed point levels
+#define PHEROMONE_DEPOSIT 16384
+#define PHEROMONE_SENSE 1024
+// each tick a square keeps half its level and takes an eighth of each
+// neighbour's, then loses 1 / (1 << PHEROMONE_DECAY_SHIFT) of that
+#define PHEROMONE_DECAY_SHIFT 4
+#define PHEROMONE_LANES 16
+
+typedef uint16_t PheromoneVec
+    __attribute__((vector_size(PHEROMONE_LANES * sizeof(uint16_t)), aligned(sizeof(uint16_t)), may_alias));
+
 // ordered so that +1 is a right turn and -1 is a left turn
 typedef enum {
     FACING_NORTH,
@@ -56,92 +316,704 @@ typedef enum {
     FACING_MAX,
 } Facing;
 
-typedef struct {
-    Action action;
-    int next_state;
-} Response;
+// The action in the high bits and the next state in the low four.
+typedef uint8_t Response;
+
+#define RESPONSE(action, next_state) ((Response)((action) << 4 | (next_state)))
+
+static inline Action response_action(Response response)
+{
+    return response >> 4;
+}
+
+static inline int response_next_state(Response response)
+{
+    return response & 15;
+}
+
+// Genes are padded to a word, with the unused responses zero, so that
+// crossover can pick whole genes with word masks.
+#define GENE_RESPONSES 8
 
 typedef struct {
-    Response responses[SITUATION_MAX];
+    Response responses[GENE_RESPONSES];
 } Gene;
 
-typedef struct {
+typedef union {
     Gene genes[GENE_COUNT];
+    uint64_t words[GENE_COUNT];
 } Chromosome;
 
+_Static_assert(SITUATION_MAX <= GENE_RESPONSES && sizeof(Gene) == sizeof(uint64_t), "Gene should be a word");
+_Static_assert(ACTION_MAX <= 16 && GENE_COUNT <= 16, "Response fields too narrow");
+
 typedef enum {
     ENTITY_TYPE_NONE,
     ENTITY_TYPE_CELL,
     ENTITY_TYPE_FOOD,
+    ENTITY_TYPE_WALL,
 } EntityType;
 
-typedef struct {
-    EntityType type;
-    int last_update_color;
-} Entity;
+// A grid square holds its EntityType in the top bits and either an index into
+// World::cells or the clump a food belongs to in the rest. Empty squares are 0,
+// and walls are stamped from the wall map as slots with no payload, so they
+// sense and block like any other occupied square.
+typedef uint32_t Slot;
+
+#define SLOT_TYPE_SHIFT 30
+#define SLOT_PAYLOAD_MASK ((1u << SLOT_TYPE_SHIFT) - 1)
 
 typedef struct {
     int x;
     int y;
 } Coord;
 
+// A static obstacle map, a bit per square, repeated across worlds larger than
+// it. Loaded from a PGM, where dark pixels are walls, or from text, where '#'
+// is a wall and anything else open.
+typedef struct {
+    int width;
+    int height;
+    size_t row_words;
+    uint64_t *bits;
+} WallMap;
+
+// NULL for a world with no walls but its edges.
+WallMap *wall_map = NULL;
+
+static inline bool wall_at(Coord coord)
+{
+    if (!wall_map)
+        return false;
+    int const x = coord.x % wall_map->width;
+    int const y = coord.y % wall_map->height;
+    return wall_map->bits[(size_t)y * wall_map->row_words + x / 64] >> (x % 64) & 1;
+}
+
+// Cells are packed into 16 bytes so that large populations stay cache
+// resident. The chromosome and color live in the world's genome store.
+typedef struct {
+    uint32_t genome;
+    int32_t score;
+    // index of the cell's square in World::slots
+    uint32_t pos;
+    uint16_t state : 4;
+    uint16_t facing : 2;
+    uint16_t last_update_color : 1;
+    // see cell_try_park; park_view holds the Situation in each direction
+    uint16_t parked : 1;
+    uint16_t park_view : 8;
+    union {
+        // while parked, the low bits of the tick it was parked on, otherwise
+        // the updates in a row it has stayed on its square
+        uint16_t park_tick;
+        // with TIMING_EVENT, the low bits of the event time it acts next at
+        uint16_t due;
+    };
+} Cell;
+
+_Static_assert(sizeof(Cell) == 16, "Cell should stay compact");
+_Static_assert(GENE_COUNT <= 16 && FACING_MAX <= 4, "Cell bitfields too narrow");
+
+#define GENOME_NONE UINT32_MAX
+
+// Cells with the same chromosome share a Genome, which their offspring
+// inherit as it is, unreachable states and all. Genomes are reference counted
+// and recycled through a free list once their last cell dies.
 typedef struct {
-    Entity entity;
-    int state;
-    int score;
+    // first, see InternTable
     Chromosome chromosome;
-    Facing facing;
+    uint32_t hash;
+    uint32_t refs;
+    uint32_t next_free;
+    uint32_t species;
+} Genome;
+
+// Genomes whose chromosomes behave the same, having the same canonical form,
+// make up a Species, which holds the color and statistics they share. Species
+// are counted by their cells and recycled like genomes.
+typedef struct {
+    // first, see InternTable
+    Chromosome canonical;
+    uint32_t hash;
     uint32_t color;
-} Cell;
+    uint32_t cells;
+    uint32_t next_free;
+    // over the species' life, offspring of its cells and score they ate
+    uint32_t births;
+    unsigned long eaten;
+} Species;
+
+// An open addressed table of the live records in a store of genomes or
+// species, by the chromosome each record starts with.
+typedef struct {
+    uint32_t handle;
+    uint32_t hash;
+} InternSlot;
+
+typedef struct {
+    InternSlot *slots;
+    size_t size;
+    size_t count;
+} InternTable;
+
+// The best species seen, by the score their cells ate over the species' life.
+// Species are offered when their last cell dies or their world is freed, and
+// each one admitted is appended to a file, which is read back at startup so
+// that progress carries across runs. On exit the file is rewritten with just
+// the entries, so that it doesn't grow from run to run.
+#define HALL_OF_FAME_SIZE 64
+#define HALL_OF_FAME_INDEX_SIZE (2 * HALL_OF_FAME_SIZE)
+
+typedef struct {
+    unsigned long eaten;
+    unsigned long births;
+    Chromosome chromosome;
+    uint32_t hash;
+    // where the entry is in HallOfFame::index
+    uint8_t slot;
+} Fame;
 
 typedef struct {
-    Entity entity;
-    int clump;
-} Food;
+    pthread_mutex_t lock;
+    char *path;
+    FILE *file;
+    // a min-heap on eaten
+    Fame entries[HALL_OF_FAME_SIZE];
+    size_t count;
+    // open addressed by chromosome hash, an entry's place in the heap plus
+    // one, or 0
+    uint8_t index[HALL_OF_FAME_INDEX_SIZE];
+    // what a species must beat to be admitted, read without the lock
+    unsigned long threshold;
+    // the entries as loaded, which new worlds start from with --reseed
+    Fame seeds[HALL_OF_FAME_SIZE];
+    size_t seed_count;
+} HallOfFame;
+
+// NULL unless --hall-of-fame is given.
+HallOfFame *hall_of_fame = NULL;
+bool hall_of_fame_reseed = false;
 
 typedef struct {
     Coord coord;
+    // where the clump was first placed, and the size of its initial blob,
+    // for generating lazy tiles
+    Coord origin;
+    double radius;
 } Clump;
 
+// An erand48 state. Streams are derived from a world seed and a stream number
+// so that work split into fixed batches draws the same numbers however the
+// batches are scheduled across threads.
+typedef struct {
+    unsigned short xsubi[3];
+} Rng;
+
+// high bits select what a stream is for, low bits the batch within that
+typedef enum {
+    RNG_STREAM_WORLD = 0,
+    RNG_STREAM_CELLS = 1ull << 32,
+    RNG_STREAM_FOOD = 2ull << 32,
+    RNG_STREAM_CHUNK = 3ull << 32,
+    RNG_STREAM_GA = 4ull << 32,
+    RNG_STREAM_TUNE = 5ull << 32,
+    RNG_STREAM_ASYNC = 6ull << 32,
+} RngStream;
+
+// The pheromone field's thread, which steps World::pheromones into
+// World::pheromones_next while the cells are updated.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    struct World *world;
+    // set to start a step, cleared by the thread when it's done
+    bool stepping;
+    bool stopping;
+    pthread_t thread;
+} PheromoneWorker;
+
+// when a parked cell runs out of score, if it's still parked by then
+typedef struct {
+    unsigned long tick;
+    uint32_t pos;
+} ParkDeath;
+
+// The cells due at a time with TIMING_EVENT, by index in World::cells.
 typedef struct {
+    uint32_t *cells;
+    size_t count;
+    size_t capacity;
+} EventBucket;
+
+typedef struct World {
     int width;
     int height;
+    GridLayout layout;
+    // tiles per row for GRID_LAYOUT_MORTON
+    int tiles_wide;
+    // squares allocated, including padding out to whole tiles
+    size_t slot_count;
+    Params params;
+    unsigned long tick;
+    // the color of the sweep in progress
+    int update_color;
+    // one past the square the sweep is updating, 0 before it starts and
+    // UINT32_MAX once it's done
+    uint32_t sweep_at;
+    uint64_t seed;
+    Rng rng;
     Clump clumps[CLUMP_COUNT];
-    Entity *entities[0];
+    // per tile, whether it has been generated, NULL unless the world is lazy
+    bool *chunk_ready;
+    // dense, unordered; a cell can never outnumber the squares
+    Cell *cells;
+    size_t cell_count;
+    Genome *genomes;
+    size_t genome_count;
+    size_t genome_capacity;
+    uint32_t genome_free;
+    InternTable genome_table;
+    // the live ones are species_table.count
+    Species *species;
+    size_t species_count;
+    size_t species_capacity;
+    uint32_t species_free;
+    InternTable species_table;
+    // held by births during an asynchronous sweep
+    pthread_mutex_t genome_lock;
+    Slot *slots;
+    // log2 of the spacing of squares in slots, 0 unless in a Batch
+    unsigned slot_shift;
+    // NULL without nutrient_field. Row-major whatever the layout, with a row
+    // and column of edge squares all round, which copy their neighbours before
+    // each step so that nutrients don't flow out of the world, and rows padded
+    // so that the stencil can run a whole NutrientVec past the last square.
+    float *nutrients;
+    float *nutrients_next;
+    size_t nutrient_stride;
+    // NULL without pheromones. Laid out like the nutrients. Cells only read
+    // the field during a tick, and their deposits are queued to be added once
+    // the worker's step is done.
+    uint16_t *pheromones;
+    uint16_t *pheromones_next;
+    size_t pheromone_stride;
+    PheromoneWorker *pheromone_worker;
+    uint32_t *deposits;
+    size_t deposit_count;
+    size_t deposit_capacity;
+    size_t parked_count;
+    unsigned long attacks;
+    unsigned long kills;
+    unsigned long reseeds;
+    // one past the tick relocate_food last found no room on, after which it
+    // doesn't look again until the next tick
+    unsigned long full_tick;
+    // score cells have taken from food and nutrients
+    unsigned long eaten;
+    // per PARK_BLOCK_SIZE block of squares, the parked cells next to a square
+    // in it, so changes away from parked cells skip looking for any to wake
+    uint32_t *parked_near;
+    // binary min-heap on tick, stale entries are skipped when popped
+    ParkDeath *park_deaths;
+    size_t park_death_count;
+    size_t park_death_capacity;
+    // NULL unless timing is TIMING_EVENT. A calendar queue with a bucket per
+    // unit of event time, in a ring that reaches as far ahead as the longest
+    // action. Cells moved in the table are queued again at their new index
+    // rather than looked for, so entries whose cell isn't due then are stale
+    // and skipped.
+    EventBucket *events;
+    unsigned long event_mask;
+    // the time being processed, EVENT_TICK_COST units to a tick
+    unsigned long event_time;
 } World;
 
+#define HUGE_PAGE_SIZE (2 << 20)
+
+typedef enum {
+    PAGE_BACKING_NORMAL,
+    // transparent huge pages were requested with madvise
+    PAGE_BACKING_TRANSPARENT,
+    // explicitly reserved huge pages from MAP_HUGETLB
+    PAGE_BACKING_HUGETLB,
+} PageBacking;
+
+static char const *const page_backing_names[] = {
+    [PAGE_BACKING_NORMAL] = "normal",
+    [PAGE_BACKING_TRANSPARENT] = "transparent huge",
+    [PAGE_BACKING_HUGETLB] = "hugetlb",
+};
+
+// Grids, cell tables and the genome store run to gigabytes on big worlds,
+// where TLB misses from 4K pages cost a lot. They are mapped directly, trying
+// MAP_HUGETLB first, then huge page aligned memory advised for transparent
+// huge pages, then plain pages. Regions smaller than a huge page just get
+// plain pages. Live mappings are kept in a list for huge_alloc_report.
+typedef struct HugeAlloc {
+    char const *name;
+    void *addr;
+    size_t size;
+    PageBacking backing;
+    struct HugeAlloc *next;
+} HugeAlloc;
+
+// worlds are made and freed on parallel_for threads by run_ga
+static HugeAlloc *huge_allocs;
+static pthread_mutex_t huge_allocs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *map_anonymous(size_t size, int flags)
+{
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+// Returns zeroed memory. Aborts when out of memory, like the rest of gasim.
+void *huge_alloc(char const *name, size_t size)
+{
+    PageBacking backing = PAGE_BACKING_NORMAL;
+    void *addr = NULL;
+    bool const huge = huge_pages && size >= HUGE_PAGE_SIZE;
+    size_t const page_size = huge ? HUGE_PAGE_SIZE : 4096;
+    size = (size + page_size - 1) & ~(page_size - 1);
+    if (huge) {
+        addr = map_anonymous(size, MAP_HUGETLB);
+        if (addr)
+            backing = PAGE_BACKING_HUGETLB;
+    }
+    if (!addr && huge) {
+        // over map so that the region can be trimmed to huge page alignment
+        char *raw = map_anonymous(size + HUGE_PAGE_SIZE, MAP_NORESERVE);
+        if (raw) {
+            char *aligned = (char *)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+            if (aligned != raw)
+                munmap(raw, aligned - raw);
+            munmap(aligned + size, raw + HUGE_PAGE_SIZE - aligned);
+            addr = aligned;
+            if (!madvise(addr, size, MADV_HUGEPAGE))
+                backing = PAGE_BACKING_TRANSPARENT;
+        }
+    }
+    if (!addr)
+        addr = map_anonymous(size, MAP_NORESERVE);
+    if (!addr)
+        abort();
+    HugeAlloc *alloc = malloc(sizeof(HugeAlloc));
+    pthread_mutex_lock(&huge_allocs_lock);
+    *alloc = (HugeAlloc){name, addr, size, backing, huge_allocs};
+    huge_allocs = alloc;
+    pthread_mutex_unlock(&huge_allocs_lock);
+    return addr;
+}
+
+static HugeAlloc **huge_alloc_find(void *addr)
+{
+    HugeAlloc **link = &huge_allocs;
+    while (*link && (*link)->addr != addr)
+        link = &(*link)->next;
+    assert(*link);
+    return link;
+}
+
+void huge_free(void *addr)
+{
+    if (!addr)
+        return;
+    pthread_mutex_lock(&huge_allocs_lock);
+    HugeAlloc **link = huge_alloc_find(addr);
+    HugeAlloc *alloc = *link;
+    *link = alloc->next;
+    pthread_mutex_unlock(&huge_allocs_lock);
+    munmap(addr, alloc->size);
+    free(alloc);
+}
+
+// Grows a huge_alloc region, or makes a new one if addr is NULL.
+void *huge_realloc(char const *name, void *addr, size_t size)
+{
+    if (!addr)
+        return huge_alloc(name, size);
+    pthread_mutex_lock(&huge_allocs_lock);
+    size_t const old_size = (*huge_alloc_find(addr))->size;
+    pthread_mutex_unlock(&huge_allocs_lock);
+    if (size <= old_size)
+        return addr;
+    void *new_addr = huge_alloc(name, size);
+    memcpy(new_addr, addr, old_size);
+    huge_free(addr);
+    return new_addr;
+}
+
+// Reads the kernel's count of huge page backed memory for the mapping at addr.
+static long smaps_anon_huge_kb(void const *addr)
+{
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (!smaps)
+        return -1;
+    long kb = -1;
+    bool in_mapping = false;
+    char line[256];
+    while (fgets(line, sizeof(line), smaps)) {
+        uintptr_t start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            if (in_mapping)
+                break;
+            in_mapping = start <= (uintptr_t)addr && (uintptr_t)addr < end;
+        } else if (in_mapping) {
+            sscanf(line, "AnonHugePages: %ld kB", &kb);
+        }
+    }
+    fclose(smaps);
+    return kb;
+}
+
+void huge_alloc_report(FILE *out)
+{
+    pthread_mutex_lock(&huge_allocs_lock);
+    for (HugeAlloc const *alloc = huge_allocs; alloc; alloc = alloc->next) {
+        fprintf(out, "%-8s %8.1f MiB  %s pages", alloc->name, alloc->size / 1048576.0,
+            page_backing_names[alloc->backing]);
+        if (alloc->backing == PAGE_BACKING_TRANSPARENT)
+            fprintf(out, ", %ld kB huge page backed", smaps_anon_huge_kb(alloc->addr));
+        fputc('\n', out);
+    }
+    pthread_mutex_unlock(&huge_allocs_lock);
+}
+
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+Rng rng_new(uint64_t seed, uint64_t stream)
+{
+    uint64_t const bits = splitmix64(seed ^ splitmix64(stream));
+    return (Rng){{bits, bits >> 16, bits >> 32}};
+}
+
+// uniform in [0, n)
+static inline long rng_int(Rng *rng, long n)
+{
+    return nrand48(rng->xsubi) % n;
+}
+
+static inline double rng_double(Rng *rng)
+{
+    return erand48(rng->xsubi);
+}
+
+typedef struct {
+    void (*fn)(void *ctx, size_t task);
+    void *ctx;
+    size_t count;
+    size_t next;
+} ParallelFor;
+
+// parallel_for calls from inside a task run serially rather than oversubscribe.
+// run_ga and run_tune rely on this: each task steps a whole world on its own
+// thread, so their results don't depend on the thread count.
+static __thread bool in_parallel_for;
+
+static void *parallel_for_worker(void *arg)
+{
+    ParallelFor *pf = arg;
+    bool const nested = in_parallel_for;
+    in_parallel_for = true;
+    for (size_t task; (task = __atomic_fetch_add(&pf->next, 1, __ATOMIC_RELAXED)) < pf->count;)
+        pf->fn(pf->ctx, task);
+    in_parallel_for = nested;
+    return NULL;
+}
+
+int parallel_thread_count(void)
+{
+    if (thread_count > 0)
+        return thread_count;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? online : 1;
+}
+
+// Calls fn for every task in [0, count), spread over parallel_thread_count
+// threads including the caller, and returns once all have finished.
+void parallel_for(size_t count, void (*fn)(void *ctx, size_t task), void *ctx)
+{
+    ParallelFor pf = {fn, ctx, count, 0};
+    size_t threads = in_parallel_for ? 1 : parallel_thread_count();
+    if (threads > count)
+        threads = count;
+    pthread_t workers[threads > 1 ? threads - 1 : 1];
+    size_t started = 0;
+    for (; started + 1 < threads; ++started) {
+        if (pthread_create(&workers[started], NULL, parallel_for_worker, &pf))
+            break;
+    }
+    parallel_for_worker(&pf);
+    for (size_t i = 0; i < started; ++i)
+        pthread_join(workers[i], NULL);
+}
+
 bool coord_in_bounds(Coord coord, World const *world)
 {
     return coord.x >= 0 && coord.x < world->width
         && coord.y >= 0 && coord.y < world->height;
 }
 
-static Entity **world_get_entity_ref(World *world, Coord coord)
+static inline EntityType slot_type(Slot slot)
+{
+    return slot >> SLOT_TYPE_SHIFT;
+}
+
+static inline Slot slot_from_food(int clump)
+{
+    return (Slot)ENTITY_TYPE_FOOD << SLOT_TYPE_SHIFT | clump;
+}
+
+static inline Slot slot_from_wall(void)
+{
+    return (Slot)ENTITY_TYPE_WALL << SLOT_TYPE_SHIFT;
+}
+
+static inline int slot_food_clump(Slot slot)
+{
+    assert(slot_type(slot) == ENTITY_TYPE_FOOD);
+    return slot & SLOT_PAYLOAD_MASK;
+}
+
+static inline Slot slot_from_cell(uint32_t index)
+{
+    assert(index <= SLOT_PAYLOAD_MASK);
+    return (Slot)ENTITY_TYPE_CELL << SLOT_TYPE_SHIFT | index;
+}
+
+static inline uint32_t slot_cell(Slot slot)
+{
+    assert(slot_type(slot) == ENTITY_TYPE_CELL);
+    return slot & SLOT_PAYLOAD_MASK;
+}
+
+static inline Cell *world_slot_cell(World *world, Slot slot)
+{
+    return &world->cells[slot_cell(slot)];
+}
+
+static inline uint32_t world_cell_index(World const *world, Cell const *cell)
+{
+    return cell - world->cells;
+}
+
+// spreads the low 16 bits of value out to the even bits
+static inline uint32_t bits_spread(uint32_t value)
+{
+#ifdef __BMI2__
+    return _pdep_u32(value, 0x55555555);
+#else
+    value &= 0xffff;
+    value = (value | value << 8) & 0x00ff00ff;
+    value = (value | value << 4) & 0x0f0f0f0f;
+    value = (value | value << 2) & 0x33333333;
+    value = (value | value << 1) & 0x55555555;
+    return value;
+#endif
+}
+
+// inverse of bits_spread
+static inline uint32_t bits_compact(uint32_t value)
+{
+#ifdef __BMI2__
+    return _pext_u32(value, 0x55555555);
+#else
+    value &= 0x55555555;
+    value = (value | value >> 1) & 0x33333333;
+    value = (value | value >> 2) & 0x0f0f0f0f;
+    value = (value | value >> 4) & 0x00ff00ff;
+    value = (value | value >> 8) & 0x0000ffff;
+    return value;
+#endif
+}
+
+static inline uint32_t morton_encode(uint32_t x, uint32_t y)
+{
+    return bits_spread(x) | bits_spread(y) << 1;
+}
+
+// index of an in bounds coord in World::slots
+static inline uint32_t world_index(World const *world, Coord coord)
+{
+    switch (world->layout) {
+    case GRID_LAYOUT_ROW_MAJOR:
+        return coord.y * world->width + coord.x;
+    case GRID_LAYOUT_MORTON:
+        {
+            uint32_t tile = (coord.y >> TILE_SHIFT) * world->tiles_wide + (coord.x >> TILE_SHIFT);
+            return tile << (2 * TILE_SHIFT)
+                | morton_encode(coord.x & (TILE_SIZE - 1), coord.y & (TILE_SIZE - 1));
+        }
+    default:
+        abort();
+    }
+}
+
+// inverse of world_index, padding squares decode out of bounds
+static inline Coord world_coord(World const *world, uint32_t index)
+{
+    switch (world->layout) {
+    case GRID_LAYOUT_ROW_MAJOR:
+        return (Coord){.x = index % world->width, .y = index / world->width};
+    case GRID_LAYOUT_MORTON:
+        {
+            uint32_t tile = index >> (2 * TILE_SHIFT);
+            uint32_t local = index & (TILE_AREA - 1);
+            return (Coord) {
+                .x = (tile % world->tiles_wide) << TILE_SHIFT | bits_compact(local),
+                .y = (tile / world->tiles_wide) << TILE_SHIFT | bits_compact(local >> 1),
+            };
+        }
+    default:
+        abort();
+    }
+}
+
+// A world stepped in a Batch shares an interleaved grid with the others in it,
+// so its squares are 1 << slot_shift slots apart.
+static inline Slot *world_slot(World const *world, uint32_t index)
+{
+    return &world->slots[(size_t)index << world->slot_shift];
+}
+
+static void world_generate_chunk(World *world, uint32_t chunk);
+
+static Slot *world_get_slot_ref(World *world, Coord coord)
 {
     if (coord.x >= 0 && coord.x < world->width
         && coord.y >= 0 && coord.y < world->height)
     {
-        return &world->entities[coord.y * world->width + coord.x];
+        uint32_t const index = world_index(world, coord);
+        uint32_t const chunk = index >> (2 * TILE_SHIFT);
+        if (world->chunk_ready && !world->chunk_ready[chunk])
+            world_generate_chunk(world, chunk);
+        return world_slot(world, index);
     }
     return NULL;
 }
 
-Facing facing_random()
+// Picks one of the actions that mutation can produce.
+static Action action_random(Rng *rng)
 {
-    static int facing;
-    return ++facing % FACING_MAX;
+    Action const action = rng_int(rng, action_count());
+    return action == ACTION_ATTACK && !predation ? ACTION_DEPOSIT : action;
 }
 
-Chromosome chromosome_random()
+Chromosome chromosome_random(Rng *rng)
 {
     Chromosome ret;
-    memset(&ret, -1, sizeof(ret));
+    memset(&ret, 0, sizeof(ret));
     for (size_t i = 0; i < GENE_COUNT; ++i) {
-        for (size_t j = 0; j < SITUATION_MAX; ++j) {
-            ret.genes[i].responses[j] = (Response) {
-                .action = lrand48() % ACTION_MAX,
-                .next_state = lrand48() % GENE_COUNT,
-            };
+        for (int j = 0; j < situation_count(); ++j) {
+            Action const action = action_random(rng);
+            ret.genes[i].responses[j] = RESPONSE(action, rng_int(rng, GENE_COUNT));
         }
     }
     return ret;
@@ -155,34 +1027,62 @@ Facing facing_turn(Facing facing, int turn)
     return (facing + turn) % FACING_MAX;
 }
 
-void chromosome_mutate(Chromosome *c)
+void chromosome_mutate(Chromosome *c, double rate, Rng *rng)
 {
     for (size_t state = 0; state < GENE_COUNT; ++state) {
-        for (size_t situation = 0; situation < SITUATION_MAX; ++situation) {
+        for (int situation = 0; situation < situation_count(); ++situation) {
             Response *response = &c->genes[state].responses[situation];
-            if (drand48() < MUTATION_RATE)
-                response->action = lrand48() % ACTION_MAX;
-            if (drand48() < MUTATION_RATE)
-                response->next_state = lrand48() % GENE_COUNT;
+            if (rng_double(rng) < rate)
+                *response = RESPONSE(action_random(rng), response_next_state(*response));
+            if (rng_double(rng) < rate)
+                *response = RESPONSE(response_action(*response), rng_int(rng, GENE_COUNT));
+        }
+    }
+}
+
+// Replaces some of the genes of a chromosome with a mate's.
+void chromosome_cross(Chromosome *c, Chromosome const *mate, Mating mode, Rng *rng)
+{
+    switch (mode) {
+    case MATING_NONE:
+        break;
+    case MATING_UNIFORM:
+        {
+            unsigned const picks = rng_int(rng, 1 << GENE_COUNT);
+            for (size_t gene = 0; gene < GENE_COUNT; ++gene) {
+                uint64_t const mask = -(uint64_t)(picks >> gene & 1);
+                c->words[gene] = (c->words[gene] & ~mask) | (mate->words[gene] & mask);
+            }
+        }
+        break;
+    case MATING_ONE_POINT:
+        {
+            size_t const point = 1 + rng_int(rng, GENE_COUNT - 1);
+            memcpy(&c->words[point], &mate->words[point], (GENE_COUNT - point) * sizeof(uint64_t));
         }
+        break;
+    default:
+        abort();
     }
 }
 
 // could return SDL_Color?
-uint32_t cell_get_color(Cell const *cell)
+uint32_t chromosome_color(Chromosome const *chromosome)
 {
     uint32_t value = 0;
     for (size_t gene = 0; gene < GENE_COUNT; ++gene) {
         uint32_t series = 0;
-        for (size_t situation = 0; situation < SITUATION_MAX; ++situation) {
-            Response const *response = &cell->chromosome.genes[gene].responses[situation];
+        for (size_t situation = 0; situation < SITUATION_TRAIL; ++situation) {
+            // responses of the first four actions fit in six bits, later
+            // ones spill into the next response's bits
             series = series << 6;
-            series |= response->action * 16 + response->next_state % 16;
+            series ^= chromosome->genes[gene].responses[situation];
         }
-        assert(series < (1 << 24));
+        // zero without pheromones, leaving those colors as they were
+        series ^= (uint32_t)chromosome->genes[gene].responses[SITUATION_TRAIL] << 9;
         value = value ^ series;
     }
-    return value;
+    return value & 0xffffff;
 }
 
 Chromosome chromosome_big_square(void)
@@ -191,334 +1091,3383 @@ Chromosome chromosome_big_square(void)
     for (size_t gene = 0; gene < 15; ++gene) {
         c.genes[gene] = (Gene) {
             .responses = {
-                [SITUATION_EMPTY ... SITUATION_FOOD] = {ACTION_MOVE_FORWARD, gene + 1},
-                [SITUATION_LIFE ... SITUATION_WALL] = {ACTION_TURN_LEFT, 0},
+                [SITUATION_EMPTY ... SITUATION_FOOD] = RESPONSE(ACTION_MOVE_FORWARD, gene + 1),
+                [SITUATION_LIFE ... SITUATION_WALL] = RESPONSE(ACTION_TURN_LEFT, 0),
             }
         };
     }
-    c.genes[15] = (Gene){.responses = {{ACTION_TURN_LEFT, 0}}};
-    c.genes[15].responses[SITUATION_FOOD] = (Response){ACTION_MOVE_FORWARD, 15};
+    c.genes[15] = (Gene){.responses = {RESPONSE(ACTION_TURN_LEFT, 0)}};
+    c.genes[15].responses[SITUATION_FOOD] = RESPONSE(ACTION_MOVE_FORWARD, 15);
     return c;
 }
 
-Cell *cell_new(Cell *parent)
+// Rewrites a chromosome into a canonical form of its behaviour from state 0,
+// which cells are born in. States that can't be reached are dropped, states
+// that respond alike are merged by partition refinement, and the rest are
+// numbered in breadth first order. Unused genes are filled by repeating the
+// used ones, so chromosomes that behave the same end up identical. Returns
+// the number of states used.
+int chromosome_canonicalize(Chromosome *chromosome)
 {
-    Cell *cell = malloc(sizeof(Cell));
-    *cell = (Cell) {
-        .entity = (Entity) {
-            .type = ENTITY_TYPE_CELL,
-            .last_update_color = -1},
-    };
-    if (parent) {
-        cell->entity.last_update_color = parent->entity.last_update_color;
-        cell->chromosome = parent->chromosome;
-        chromosome_mutate(&cell->chromosome);
-        cell->facing = facing_turn(parent->facing, 2);
-        cell->score = CELL_START_SCORE;
-    } else {
-        cell->chromosome = /*chromosome_random()*/chromosome_big_square();
-        chromosome_mutate(&cell->chromosome);
-        cell->facing = facing_random();
-        cell->score = CELL_START_SCORE;
+    Gene const *genes = chromosome->genes;
+    int reached[GENE_COUNT] = {0};
+    bool seen[GENE_COUNT] = {[0] = true};
+    int reached_count = 1;
+    for (int i = 0; i < reached_count; ++i) {
+        for (Situation situation = 0; situation < SITUATION_MAX; ++situation) {
+            int const next = response_next_state(genes[reached[i]].responses[situation]);
+            if (!seen[next]) {
+                seen[next] = true;
+                reached[reached_count++] = next;
+            }
+        }
     }
-    cell->color = cell_get_color(cell);
-    return cell;
-}
-
-Food *food_new(void)
-{
-    Food *food = malloc(sizeof(Food));
-    *food = (Food) {
-        .entity = {ENTITY_TYPE_FOOD},
-        .clump = -1,
-    };
-    return food;
-}
-
-int random_int(int min, int max)
-{
-    unsigned int range = max - min;
-    long value = mrand48() % range;
-    if (value < 0) value += range;
+    // split classes of states until every state in a class has the same
+    // actions and goes to the same classes
+    int class[GENE_COUNT] = {0};
+    int class_count = 1;
+    for (;;) {
+        int split[GENE_COUNT];
+        int split_count = 0;
+        for (int i = 0; i < reached_count; ++i) {
+            Gene const *gene = &genes[reached[i]];
+            split[reached[i]] = -1;
+            for (int j = 0; j < i && split[reached[i]] < 0; ++j) {
+                Gene const *other = &genes[reached[j]];
+                bool same = class[reached[i]] == class[reached[j]];
+                for (Situation situation = 0; same && situation < SITUATION_MAX; ++situation) {
+                    Response const response = gene->responses[situation];
+                    Response const other_response = other->responses[situation];
+                    same = response_action(response) == response_action(other_response)
+                        && class[response_next_state(response)] == class[response_next_state(other_response)];
+                }
+                if (same)
+                    split[reached[i]] = split[reached[j]];
+            }
+            if (split[reached[i]] < 0)
+                split[reached[i]] = split_count++;
+        }
+        memcpy(class, split, sizeof(class));
+        if (split_count == class_count)
+            break;
+        class_count = split_count;
+    }
+    // number the classes breadth first from state 0's
+    int number[GENE_COUNT];
+    int member[GENE_COUNT];
+    memset(number, -1, sizeof(number));
+    number[class[0]] = 0;
+    member[0] = 0;
+    int numbered = 1;
+    for (int i = 0; i < numbered; ++i) {
+        for (Situation situation = 0; situation < SITUATION_MAX; ++situation) {
+            int const next = response_next_state(genes[member[i]].responses[situation]);
+            if (number[class[next]] < 0) {
+                number[class[next]] = numbered;
+                member[numbered++] = next;
+            }
+        }
+    }
+    Chromosome canonical;
+    memset(&canonical, 0, sizeof(canonical));
+    for (int state = 0; state < GENE_COUNT; ++state) {
+        Gene const *gene = &genes[member[state % class_count]];
+        for (Situation situation = 0; situation < SITUATION_MAX; ++situation) {
+            Response const response = gene->responses[situation];
+            canonical.genes[state].responses[situation] = RESPONSE(
+                response_action(response), number[class[response_next_state(response)]]);
+        }
+    }
+    *chromosome = canonical;
+    return class_count;
+}
+
+uint32_t chromosome_hash(Chromosome const *chromosome)
+{
+    uint64_t hash = 0;
+    for (size_t gene = 0; gene < GENE_COUNT; ++gene)
+        hash = (hash ^ chromosome->words[gene]) * 0x9e3779b97f4a7c15ull;
+    return hash ^ hash >> 32;
+}
+
+// Returns where a chromosome's record is or would go in a table of a store
+// of records stride bytes apart.
+static size_t intern_table_find(InternTable const *table, void const *store, size_t stride,
+    Chromosome const *chromosome, uint32_t hash)
+{
+    size_t const mask = table->size - 1;
+    size_t i = hash & mask;
+    for (InternSlot const *slot; (slot = &table->slots[i])->handle != GENOME_NONE; i = (i + 1) & mask) {
+        Chromosome const *other = (Chromosome const *)((char const *)store + slot->handle * stride);
+        if (slot->hash == hash && !memcmp(other, chromosome, sizeof(Chromosome)))
+            break;
+    }
+    return i;
+}
+
+// Rebuilds a table with room for at least the given records.
+static void intern_table_reserve(InternTable *table, char const *name, size_t count)
+{
+    size_t size = 64;
+    while (size < 2 * count)
+        size *= 2;
+    if (size <= table->size)
+        return;
+    InternSlot *const old = table->slots;
+    size_t const old_size = table->size;
+    table->slots = huge_alloc(name, size * sizeof(InternSlot));
+    table->size = size;
+    memset(table->slots, -1, size * sizeof(InternSlot));
+    for (size_t j = 0; j < old_size; ++j) {
+        if (old[j].handle == GENOME_NONE)
+            continue;
+        size_t i = old[j].hash & (size - 1);
+        while (table->slots[i].handle != GENOME_NONE)
+            i = (i + 1) & (size - 1);
+        table->slots[i] = old[j];
+    }
+    if (old)
+        huge_free(old);
+}
+
+// Puts a record where intern_table_find said it would go.
+static void intern_table_insert(InternTable *table, size_t i, uint32_t handle, uint32_t hash)
+{
+    table->slots[i] = (InternSlot) {handle, hash};
+    ++table->count;
+}
+
+// Removes a record from a table, shifting back any entries that probed past
+// it so lookups don't stop short.
+static void intern_table_remove(InternTable *table, uint32_t handle, uint32_t hash)
+{
+    size_t const mask = table->size - 1;
+    size_t i = hash & mask;
+    while (table->slots[i].handle != handle)
+        i = (i + 1) & mask;
+    for (size_t j = i;;) {
+        j = (j + 1) & mask;
+        InternSlot const moving = table->slots[j];
+        if (moving.handle == GENOME_NONE)
+            break;
+        size_t const home = moving.hash & mask;
+        // entries whose probe starts after the hole stay put
+        if (i < j ? home > i && home <= j : home > i || home <= j)
+            continue;
+        table->slots[i] = moving;
+        i = j;
+    }
+    table->slots[i].handle = GENOME_NONE;
+    --table->count;
+}
+
+// Makes room for count more genomes, so that the store won't move while they
+// are added.
+static void genome_reserve(World *world, size_t count)
+{
+    size_t capacity = world->genome_capacity;
+    while (capacity < world->genome_count + count)
+        capacity = capacity * 2 + 64;
+    if (capacity == world->genome_capacity)
+        return;
+    world->genome_capacity = capacity;
+    world->genomes = huge_realloc("genomes", world->genomes, capacity * sizeof(Genome));
+}
+
+// Likewise for species.
+static void species_reserve(World *world, size_t count)
+{
+    size_t capacity = world->species_capacity;
+    while (capacity < world->species_count + count)
+        capacity = capacity * 2 + 64;
+    if (capacity == world->species_capacity)
+        return;
+    world->species_capacity = capacity;
+    world->species = huge_realloc("species", world->species, capacity * sizeof(Species));
+}
+
+// Returns the species with a canonical chromosome, adding one with no cells
+// if there isn't one already.
+static uint32_t species_intern(World *world, Chromosome const *canonical, uint32_t hash)
+{
+    intern_table_reserve(&world->species_table, "species table", world->species_table.count + 1);
+    size_t const slot = intern_table_find(&world->species_table, world->species, sizeof(Species), canonical, hash);
+    uint32_t handle = world->species_table.slots[slot].handle;
+    if (handle != GENOME_NONE)
+        return handle;
+    handle = world->species_free;
+    if (handle != GENOME_NONE) {
+        world->species_free = world->species[handle].next_free;
+    } else {
+        species_reserve(world, 1);
+        handle = world->species_count++;
+    }
+    world->species[handle] = (Species) {
+        .canonical = *canonical,
+        .hash = hash,
+        .color = chromosome_color(canonical),
+        .next_free = GENOME_NONE,
+    };
+    intern_table_insert(&world->species_table, slot, handle, hash);
+    return handle;
+}
+
+static inline void genome_ref(World *world, uint32_t handle)
+{
+    ++world->genomes[handle].refs;
+    ++world->species[world->genomes[handle].species].cells;
+}
+
+static inline Species *cell_species(World const *world, Cell const *cell)
+{
+    return &world->species[world->genomes[cell->genome].species];
+}
+
+// genome_intern for a chromosome already hashed. canonical is its canonical
+// form if that's been worked out too, or NULL.
+static uint32_t genome_intern_hashed(World *world, Chromosome const *chromosome, uint32_t hash,
+    Chromosome const *canonical)
+{
+    intern_table_reserve(&world->genome_table, "genome table", world->genome_table.count + 1);
+    size_t const slot = intern_table_find(&world->genome_table, world->genomes, sizeof(Genome), chromosome, hash);
+    uint32_t handle = world->genome_table.slots[slot].handle;
+    if (handle == GENOME_NONE) {
+        Chromosome reduced;
+        if (!canonical) {
+            reduced = *chromosome;
+            chromosome_canonicalize(&reduced);
+            canonical = &reduced;
+        }
+        uint32_t const species = species_intern(world, canonical, chromosome_hash(canonical));
+        handle = world->genome_free;
+        if (handle != GENOME_NONE) {
+            world->genome_free = world->genomes[handle].next_free;
+        } else {
+            genome_reserve(world, 1);
+            handle = world->genome_count++;
+        }
+        world->genomes[handle] = (Genome) {
+            .chromosome = *chromosome,
+            .hash = hash,
+            .next_free = GENOME_NONE,
+            .species = species,
+        };
+        intern_table_insert(&world->genome_table, slot, handle, hash);
+    }
+    genome_ref(world, handle);
+    return handle;
+}
+
+// Returns a reference to the genome with the chromosome, adding one if there
+// isn't one already.
+uint32_t genome_intern(World *world, Chromosome const *chromosome)
+{
+    return genome_intern_hashed(world, chromosome, chromosome_hash(chromosome), NULL);
+}
+
+// Puts an entry at a place in the heap, keeping the index pointing at it.
+static void fame_place(HallOfFame *hall, size_t i, Fame const *fame)
+{
+    hall->entries[i] = *fame;
+    hall->index[fame->slot] = i + 1;
+}
+
+static void fame_sift_up(HallOfFame *hall, size_t i)
+{
+    Fame const fame = hall->entries[i];
+    for (; i && hall->entries[(i - 1) / 2].eaten > fame.eaten; i = (i - 1) / 2)
+        fame_place(hall, i, &hall->entries[(i - 1) / 2]);
+    fame_place(hall, i, &fame);
+}
+
+static void fame_sift_down(HallOfFame *hall, size_t i)
+{
+    Fame const fame = hall->entries[i];
+    for (size_t child; (child = 2 * i + 1) < hall->count; i = child) {
+        if (child + 1 < hall->count && hall->entries[child + 1].eaten < hall->entries[child].eaten)
+            ++child;
+        if (hall->entries[child].eaten >= fame.eaten)
+            break;
+        fame_place(hall, i, &hall->entries[child]);
+    }
+    fame_place(hall, i, &fame);
+}
+
+// Returns where an entry's chromosome is or would go in the index.
+static size_t fame_index_find(HallOfFame const *hall, Fame const *fame)
+{
+    size_t i = fame->hash % HALL_OF_FAME_INDEX_SIZE;
+    for (uint8_t at; (at = hall->index[i]); i = (i + 1) % HALL_OF_FAME_INDEX_SIZE) {
+        Fame const *other = &hall->entries[at - 1];
+        if (other->hash == fame->hash && !memcmp(&other->chromosome, &fame->chromosome, sizeof(Chromosome)))
+            break;
+    }
+    return i;
+}
+
+// Empties a slot of the index, shifting back any entries that probed past it.
+static void fame_index_remove(HallOfFame *hall, size_t i)
+{
+    for (size_t j = i;;) {
+        j = (j + 1) % HALL_OF_FAME_INDEX_SIZE;
+        uint8_t const moving = hall->index[j];
+        if (!moving)
+            break;
+        size_t const home = hall->entries[moving - 1].hash % HALL_OF_FAME_INDEX_SIZE;
+        if (i < j ? home > i && home <= j : home > i || home <= j)
+            continue;
+        hall->index[i] = moving;
+        hall->entries[moving - 1].slot = i;
+        i = j;
+    }
+    hall->index[i] = 0;
+}
+
+// Adds an entry if it beats the least, or an entry for the same chromosome.
+// Called with the lock held.
+static bool hall_of_fame_admit(HallOfFame *hall, Fame const *fame)
+{
+    // every entry has eaten at least as much as the least
+    if (hall->count == HALL_OF_FAME_SIZE && hall->entries[0].eaten >= fame->eaten)
+        return false;
+    Fame entry = *fame;
+    entry.hash = chromosome_hash(&entry.chromosome);
+    size_t const slot = fame_index_find(hall, &entry);
+    size_t const at = hall->index[slot];
+    if (at) {
+        if (hall->entries[at - 1].eaten >= entry.eaten)
+            return false;
+        entry.slot = slot;
+        fame_place(hall, at - 1, &entry);
+        fame_sift_down(hall, at - 1);
+    } else if (hall->count < HALL_OF_FAME_SIZE) {
+        entry.slot = slot;
+        fame_place(hall, hall->count++, &entry);
+        fame_sift_up(hall, hall->count - 1);
+    } else {
+        // removing the least can move the slot the entry would go in
+        fame_index_remove(hall, hall->entries[0].slot);
+        entry.slot = fame_index_find(hall, &entry);
+        fame_place(hall, 0, &entry);
+        fame_sift_down(hall, 0);
+    }
+    if (hall->count == HALL_OF_FAME_SIZE)
+        __atomic_store_n(&hall->threshold, hall->entries[0].eaten, __ATOMIC_RELAXED);
+    return true;
+}
+
+static void fame_write(FILE *out, Fame const *fame)
+{
+    fprintf(out, "%lu %lu", fame->eaten, fame->births);
+    for (size_t word = 0; word < GENE_COUNT; ++word)
+        fprintf(out, " %016llx", (unsigned long long)fame->chromosome.words[word]);
+    fputc('\n', out);
+}
+
+static void hall_of_fame_offer(Species const *species)
+{
+    HallOfFame *hall = hall_of_fame;
+    if (species->eaten <= __atomic_load_n(&hall->threshold, __ATOMIC_RELAXED))
+        return;
+    Fame const fame = {.eaten = species->eaten, .births = species->births, .chromosome = species->canonical};
+    pthread_mutex_lock(&hall->lock);
+    if (hall_of_fame_admit(hall, &fame)) {
+        fame_write(hall->file, &fame);
+        fflush(hall->file);
+    }
+    pthread_mutex_unlock(&hall->lock);
+}
+
+// A random entry of the hall of fame as it stands, which must not be empty.
+static Chromosome hall_of_fame_pick(Rng *rng)
+{
+    HallOfFame *hall = hall_of_fame;
+    pthread_mutex_lock(&hall->lock);
+    Chromosome const chromosome = hall->entries[rng_int(rng, hall->count)].chromosome;
+    pthread_mutex_unlock(&hall->lock);
+    return chromosome;
+}
+
+static int compare_fame(void const *a, void const *b)
+{
+    Fame const *x = a;
+    Fame const *y = b;
+    return (x->eaten < y->eaten) - (x->eaten > y->eaten);
+}
+
+// Rewrites the hall of fame file with just the entries, best first. The new
+// file replaces the old only once it's complete.
+static void hall_of_fame_save(void)
+{
+    HallOfFame *hall = hall_of_fame;
+    pthread_mutex_lock(&hall->lock);
+    fclose(hall->file);
+    hall->file = NULL;
+    Fame entries[HALL_OF_FAME_SIZE];
+    memcpy(entries, hall->entries, hall->count * sizeof(Fame));
+    qsort(entries, hall->count, sizeof(Fame), compare_fame);
+    size_t const size = strlen(hall->path) + sizeof(".new");
+    char temporary[size];
+    snprintf(temporary, size, "%s.new", hall->path);
+    FILE *out = fopen(temporary, "w");
+    if (out) {
+        for (size_t i = 0; i < hall->count; ++i)
+            fame_write(out, &entries[i]);
+        if (fclose(out) || rename(temporary, hall->path)) {
+            perror(hall->path);
+            remove(temporary);
+        }
+    } else {
+        perror(temporary);
+    }
+    pthread_mutex_unlock(&hall->lock);
+}
+
+// Loads the best entries of a hall of fame file and opens it to append to,
+// or prints why not and returns NULL. A missing file is an empty hall. The
+// file is rewritten at exit.
+static HallOfFame *hall_of_fame_open(char const *path)
+{
+    HallOfFame *hall = calloc(1, sizeof(HallOfFame));
+    pthread_mutex_init(&hall->lock, NULL);
+    FILE *in = fopen(path, "r");
+    if (in) {
+        char line[512];
+        while (fgets(line, sizeof(line), in)) {
+            Fame fame;
+            char const *at = line;
+            int used;
+            if (sscanf(at, "%lu %lu%n", &fame.eaten, &fame.births, &used) != 2)
+                continue;
+            at += used;
+            size_t word = 0;
+            for (unsigned long long value; word < GENE_COUNT && sscanf(at, "%llx%n", &value, &used) == 1; ++word) {
+                fame.chromosome.words[word] = value;
+                at += used;
+            }
+            if (word == GENE_COUNT)
+                hall_of_fame_admit(hall, &fame);
+        }
+        fclose(in);
+    }
+    memcpy(hall->seeds, hall->entries, hall->count * sizeof(Fame));
+    hall->seed_count = hall->count;
+    hall->file = fopen(path, "a");
+    if (!hall->file) {
+        perror(path);
+        free(hall);
+        return NULL;
+    }
+    hall->path = strdup(path);
+    atexit(hall_of_fame_save);
+    return hall;
+}
+
+void genome_unref(World *world, uint32_t handle)
+{
+    Genome *genome = &world->genomes[handle];
+    Species *species = &world->species[genome->species];
+    assert(genome->refs > 0 && species->cells > 0);
+    if (!--species->cells) {
+        if (hall_of_fame)
+            hall_of_fame_offer(species);
+        intern_table_remove(&world->species_table, genome->species, species->hash);
+        species->next_free = world->species_free;
+        world->species_free = genome->species;
+    }
+    if (--genome->refs)
+        return;
+    intern_table_remove(&world->genome_table, handle, genome->hash);
+    genome->next_free = world->genome_free;
+    world->genome_free = handle;
+}
+
+// How long an action takes with TIMING_EVENT.
+static inline unsigned long world_action_duration(World const *world, Action action)
+{
+    int const cost = world->params.action_costs[action];
+    return cost < 1 ? 1 : cost > EVENT_DURATION_MAX ? EVENT_DURATION_MAX : cost;
+}
+
+static void world_events_init(World *world)
+{
+    unsigned long longest = 1;
+    for (Action action = 0; action < ACTION_MAX; ++action) {
+        if (world_action_duration(world, action) > longest)
+            longest = world_action_duration(world, action);
+    }
+    size_t size = 2;
+    while (size <= longest)
+        size *= 2;
+    world->events = calloc(size, sizeof(EventBucket));
+    world->event_mask = size - 1;
+}
+
+// Queues the cell at index in the table to act at time, which can be no
+// further ahead of the time being processed than the longest action.
+static void world_schedule(World *world, uint32_t index, unsigned long time)
+{
+    assert(time >= world->event_time && time - world->event_time <= world->event_mask);
+    world->cells[index].due = time;
+    EventBucket *bucket = &world->events[time & world->event_mask];
+    if (bucket->count == bucket->capacity) {
+        bucket->capacity = bucket->capacity ? 2 * bucket->capacity : 64;
+        bucket->cells = realloc(bucket->cells, bucket->capacity * sizeof(uint32_t));
+    }
+    bucket->cells[bucket->count++] = index;
+}
+
+// The time a queued cell acts at, which is never behind the time being
+// processed.
+static inline unsigned long cell_due(World const *world, Cell const *cell)
+{
+    return world->event_time + (uint16_t)(cell->due - world->event_time);
+}
+
+static inline Chromosome const *cell_chromosome(World const *world, Cell const *cell)
+{
+    return &world->genomes[cell->genome].chromosome;
+}
+
+// Appends a cell at the given square. Offspring share the parent's genome
+// unless crossing with the mate, if any, or mutation actually changed
+// something. Cells without a parent carry an unmutated big square and face
+// north. The initial population is made in
+// bulk by world_new instead.
+Cell *cell_new(World *world, Cell const *parent, Cell const *mate, uint32_t pos)
+{
+    assert(world->cell_count < (size_t)world->width * world->height);
+    Cell *cell = &world->cells[world->cell_count++];
+    *cell = (Cell) {
+        .genome = GENOME_NONE,
+        .pos = pos,
+    };
+    Chromosome chromosome;
+    if (parent) {
+        ++cell_species(world, parent)->births;
+        cell->last_update_color = parent->last_update_color;
+        chromosome = *cell_chromosome(world, parent);
+        if (mate)
+            chromosome_cross(&chromosome, cell_chromosome(world, mate), mating, &world->rng);
+        chromosome_mutate(&chromosome, world->params.mutation_rate, &world->rng);
+        if (!memcmp(&chromosome, cell_chromosome(world, parent), sizeof(chromosome))) {
+            cell->genome = parent->genome;
+            genome_ref(world, cell->genome);
+        }
+        cell->facing = facing_turn(parent->facing, 2);
+        cell->score = CELL_START_SCORE;
+    } else {
+        chromosome = chromosome_big_square();
+        cell->facing = FACING_NORTH;
+        cell->score = CELL_START_SCORE;
+    }
+    if (cell->genome == GENOME_NONE)
+        cell->genome = genome_intern(world, &chromosome);
+    *world_slot(world, pos) = slot_from_cell(world_cell_index(world, cell));
+    if (world->events)
+        world_schedule(world, world_cell_index(world, cell), world->event_time + 1);
+    return cell;
+}
+
+// Removes the cell from its square and fills the hole in the cell table with
+// the last cell.
+void cell_free(World *world, Cell *cell)
+{
+    genome_unref(world, cell->genome);
+    *world_slot(world, cell->pos) = 0;
+    Cell const *last = &world->cells[--world->cell_count];
+    if (cell != last) {
+        *cell = *last;
+        *world_slot(world, cell->pos) = slot_from_cell(world_cell_index(world, cell));
+        if (world->events)
+            world_schedule(world, world_cell_index(world, cell), cell_due(world, cell));
+    }
+}
+
+int random_int(Rng *rng, int min, int max)
+{
+    unsigned int range = max - min;
+    long value = jrand48(rng->xsubi) % range;
+    if (value < 0) value += range;
     assert(0 <= value && value < range);
     value += min;
     assert(value >= INT_MIN && value <= INT_MAX);
     return value;
 }
 
-Coord perturb_coord(Coord coord)
+Coord perturb_coord(Coord coord, Rng *rng)
+{
+    coord.x += random_int(rng, -1, 2);
+    coord.y += random_int(rng, -1, 2);
+    return coord;
+}
+
+// A random walk takes time quadratic in the size of a full area to get out of
+// it, and touches every tile in it, which would generate whole clumps of a
+// lazy world. So a walk that goes on too long heads off in a straight line in
+// a random direction, roughly where it would have come out, and carries on
+// walking from there. After NEARBY_ESCAPES_MAX of those the world is taken to
+// be full, and the starting square is returned, which the caller must check.
+#define NEARBY_WALK_STEPS 256
+#define NEARBY_ESCAPES_MAX 8
+
+Coord find_nearby_empty(Coord coord, World *world, Rng *rng)
+{
+    assert(coord_in_bounds(coord, world));
+    Coord const start = coord;
+    for (int steps = 0, escapes = 0; true; ++steps) {
+        if (steps == NEARBY_WALK_STEPS) {
+            if (++escapes > NEARBY_ESCAPES_MAX)
+                return start;
+            double const angle = 2 * M_PI * rng_double(rng);
+            double const dx = cos(angle), dy = sin(angle);
+            for (int distance = 1; true; ++distance) {
+                Coord const ahead = {
+                    .x = coord.x + lround(dx * distance),
+                    .y = coord.y + lround(dy * distance),
+                };
+                Slot *slot = world_get_slot_ref(world, ahead);
+                if (!slot)
+                    break;
+                if (!*slot)
+                    return ahead;
+            }
+            steps = 0;
+        }
+        Coord new_coord = perturb_coord(coord, rng);
+        Slot *slot = world_get_slot_ref(world, new_coord);
+        if (slot) {
+            coord = new_coord;
+            if (!*slot) return coord;
+        }
+    }
+}
+
+// the chromosome of the initial population
+Chromosome chromosome_root(double mutation_rate, Rng *rng)
+{
+    Chromosome chromosome = /*chromosome_random(rng)*/chromosome_big_square();
+    if (hall_of_fame_reseed && hall_of_fame->seed_count)
+        chromosome = hall_of_fame->seeds[rng_int(rng, hall_of_fame->seed_count)].chromosome;
+    chromosome_mutate(&chromosome, mutation_rate, rng);
+    return chromosome;
+}
+
+// Initial cells are made in fixed size batches, each from its own stream.
+#define CELL_INIT_BATCH 4096
+
+static void world_init_cells(void *ctx, size_t batch)
+{
+    World *world = ctx;
+    Rng rng = rng_new(world->seed, RNG_STREAM_CELLS + batch);
+    size_t const area = (size_t)world->width * world->height;
+    for (size_t k = batch * CELL_INIT_BATCH; k < (batch + 1) * CELL_INIT_BATCH; ++k) {
+        size_t const i = k * CELL_SCARCITY;
+        if (i >= area)
+            break;
+        Chromosome const chromosome = chromosome_root(world->params.mutation_rate, &rng);
+        Chromosome canonical = chromosome;
+        chromosome_canonicalize(&canonical);
+        world->genomes[k] = (Genome) {
+            .chromosome = chromosome,
+            .hash = chromosome_hash(&chromosome),
+            .refs = 1,
+            .next_free = GENOME_NONE,
+            .species = k,
+        };
+        world->species[k] = (Species) {
+            .canonical = canonical,
+            .hash = chromosome_hash(&canonical),
+            .color = chromosome_color(&canonical),
+            .cells = 1,
+            .next_free = GENOME_NONE,
+        };
+        Coord const coord = {.x = i % world->width, .y = i / world->width};
+        world->cells[k] = (Cell) {
+            .genome = k,
+            .score = CELL_START_SCORE,
+            .pos = world_index(world, coord),
+            .facing = (k + 1) % FACING_MAX,
+        };
+        *world_slot(world, world->cells[k].pos) = slot_from_cell(k);
+    }
+}
+
+// Food starts out as a clump the shape find_nearby_empty random walks from
+// the clump's centre would grow, a roughly round blob around the cells. Each
+// clump ranks the free squares of a disk by jittered distance from its centre,
+// in parallel against a grid holding only cells. Food is then placed down
+// each clump's ranking in clump order, so overlapping clumps resolve the same
+// way every time.
+typedef struct {
+    World *world;
+    size_t wanted[CLUMP_COUNT];
+    uint64_t *ranked[CLUMP_COUNT];
+    size_t ranked_count[CLUMP_COUNT];
+} FoodInit;
+
+static int compare_uint32(void const *a, void const *b)
+{
+    uint32_t const x = *(uint32_t const *)a;
+    uint32_t const y = *(uint32_t const *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_uint64(void const *a, void const *b)
+{
+    uint64_t const x = *(uint64_t const *)a;
+    uint64_t const y = *(uint64_t const *)b;
+    return (x > y) - (x < y);
+}
+
+static void world_init_clump(void *ctx, size_t clump)
+{
+    FoodInit *init = ctx;
+    World *const world = init->world;
+    Rng rng = rng_new(world->seed, RNG_STREAM_FOOD + clump);
+    Coord const centre = world->clumps[clump].coord;
+    size_t const wanted = init->wanted[clump];
+    // a little more than the food needs, as some squares have cells, and
+    // spare for where clumps overlap
+    double radius = sqrt(wanted * 1.2 / M_PI) + 2;
+    uint64_t *ranked = NULL;
+    size_t count;
+    while (true) {
+        int const r = ceil(radius);
+        int const x0 = centre.x - r < 0 ? 0 : centre.x - r;
+        int const y0 = centre.y - r < 0 ? 0 : centre.y - r;
+        int const x1 = centre.x + r >= world->width ? world->width - 1 : centre.x + r;
+        int const y1 = centre.y + r >= world->height ? world->height - 1 : centre.y + r;
+        ranked = realloc(ranked, (size_t)(x1 - x0 + 1) * (y1 - y0 + 1) * sizeof(*ranked));
+        count = 0;
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                double const distance = hypot(x - centre.x, y - centre.y);
+                if (distance > radius)
+                    continue;
+                uint32_t const index = world_index(world, (Coord){x, y});
+                if (*world_slot(world, index))
+                    continue;
+                uint64_t const rank = (distance + 1.5 * rng_double(&rng)) * 256;
+                ranked[count++] = rank << 32 | index;
+            }
+        }
+        bool const whole_world = x0 == 0 && y0 == 0
+            && x1 == world->width - 1 && y1 == world->height - 1;
+        if (count >= wanted + wanted / 8 || whole_world)
+            break;
+        radius *= 1.25;
+    }
+    qsort(ranked, count, sizeof(*ranked), compare_uint64);
+    init->ranked[clump] = ranked;
+    init->ranked_count[clump] = count;
+}
+
+// Lazy tiles can't rank squares across the whole clump, so a square is food if
+// its jittered distance from a clump's origin is inside the radius that the
+// clump's food would fill, deciding each square from the seed alone.
+static int lazy_food_clump(World const *world, Clump const *const clumps[], int count, Coord coord, uint32_t index)
+{
+    double const jitter = 1.5 * (splitmix64(world->seed ^ (RNG_STREAM_FOOD + index)) >> 11) * 0x1p-53;
+    for (int i = 0; i < count; ++i) {
+        Clump const *clump = clumps[i];
+        if (hypot(coord.x - clump->origin.x, coord.y - clump->origin.y) + jitter <= clump->radius)
+            return clump - world->clumps;
+    }
+    return -1;
+}
+
+// What a square holds, without generating it if it's in a lazy tile, so that
+// cells only generate tiles by moving into them rather than by looking.
+EntityType world_sense(World *world, Coord coord)
+{
+    uint32_t const index = world_index(world, coord);
+    if (!world->chunk_ready || world->chunk_ready[index >> (2 * TILE_SHIFT)])
+        return slot_type(*world_slot(world, index));
+    if (wall_at(coord))
+        return ENTITY_TYPE_WALL;
+    if (!(((size_t)coord.y * world->width + coord.x) % CELL_SCARCITY))
+        return ENTITY_TYPE_CELL;
+    if (world->nutrients)
+        return ENTITY_TYPE_NONE;
+    Clump const *clumps[CLUMP_COUNT];
+    for (size_t i = 0; i < CLUMP_COUNT; ++i)
+        clumps[i] = &world->clumps[i];
+    if (lazy_food_clump(world, clumps, CLUMP_COUNT, coord, index) >= 0)
+        return ENTITY_TYPE_FOOD;
+    return ENTITY_TYPE_NONE;
+}
+
+static void world_generate_chunk(World *world, uint32_t chunk)
+{
+    assert(world->layout == GRID_LAYOUT_MORTON);
+    world->chunk_ready[chunk] = true;
+    Rng rng = rng_new(world->seed, RNG_STREAM_CHUNK + chunk);
+    Coord const origin = world_coord(world, chunk << (2 * TILE_SHIFT));
+    Clump const *clumps[CLUMP_COUNT];
+    int clump_count = 0;
+    for (size_t i = 0; i < CLUMP_COUNT && !world->nutrients; ++i) {
+        Clump const *clump = &world->clumps[i];
+        // distance from the origin to the nearest point of the tile
+        double const dx = fmax(0, fmax(origin.x - clump->origin.x, clump->origin.x - (origin.x + TILE_SIZE - 1)));
+        double const dy = fmax(0, fmax(origin.y - clump->origin.y, clump->origin.y - (origin.y + TILE_SIZE - 1)));
+        if (hypot(dx, dy) <= clump->radius)
+            clumps[clump_count++] = clump;
+    }
+    for (int y = origin.y; y < origin.y + TILE_SIZE && y < world->height; ++y) {
+        for (int x = origin.x; x < origin.x + TILE_SIZE && x < world->width; ++x) {
+            Coord const coord = {x, y};
+            uint32_t const index = world_index(world, coord);
+            size_t const i = (size_t)y * world->width + x;
+            if (wall_at(coord)) {
+                *world_slot(world, index) = slot_from_wall();
+                continue;
+            }
+            if (!(i % CELL_SCARCITY)) {
+                Chromosome const chromosome = chromosome_root(world->params.mutation_rate, &rng);
+                Cell *cell = &world->cells[world->cell_count++];
+                *cell = (Cell) {
+                    .genome = genome_intern(world, &chromosome),
+                    .score = CELL_START_SCORE,
+                    .pos = index,
+                    .facing = (i / CELL_SCARCITY + 1) % FACING_MAX,
+                    // wait for the next sweep, or a tile generated ahead of
+                    // the sweep could generate the next and so on
+                    .last_update_color = world->update_color,
+                };
+                *world_slot(world, index) = slot_from_cell(world_cell_index(world, cell));
+                if (world->events)
+                    world_schedule(world, world_cell_index(world, cell), world->event_time + 1);
+                continue;
+            }
+            int const clump = lazy_food_clump(world, clumps, clump_count, coord, index);
+            if (clump >= 0)
+                *world_slot(world, index) = slot_from_food(clump);
+        }
+    }
+}
+
+static inline float *world_nutrient_ref(World *world, Coord coord)
+{
+    return &world->nutrients[(size_t)(coord.y + 1) * world->nutrient_stride + coord.x + 1];
+}
+
+// Takes the whole units of nutrient on a square.
+static int world_harvest(World *world, Coord coord)
+{
+    float *nutrient = world_nutrient_ref(world, coord);
+    int const harvest = *nutrient;
+    *nutrient -= harvest;
+    return harvest;
+}
+
+static void world_diffuse_band(void *ctx, size_t band)
+{
+    World const *world = ctx;
+    size_t const stride = world->nutrient_stride;
+    int y_end = (band + 1) * NUTRIENT_BAND_ROWS;
+    if (y_end > world->height)
+        y_end = world->height;
+    for (int y = band * NUTRIENT_BAND_ROWS; y < y_end; ++y) {
+        float const *row = &world->nutrients[(y + 1) * stride];
+        float *next = &world->nutrients_next[(y + 1) * stride];
+        for (int x = 1; x <= world->width; x += NUTRIENT_LANES) {
+            NutrientVec const here = *(NutrientVec const *)&row[x];
+            NutrientVec const around = *(NutrientVec const *)&row[x - 1]
+                + *(NutrientVec const *)&row[x + 1]
+                + *(NutrientVec const *)&row[x - stride]
+                + *(NutrientVec const *)&row[x + stride];
+            NutrientVec const diffused = here + NUTRIENT_DIFFUSION * (around - 4.0f * here);
+            *(NutrientVec *)&next[x] = diffused + NUTRIENT_REGROWTH * (NUTRIENT_CAPACITY - diffused);
+        }
+    }
+}
+
+// Steps the nutrient field a tick, with the stencil spread over bands of rows.
+static void world_update_nutrients(World *world)
+{
+    float *field = world->nutrients;
+    size_t const stride = world->nutrient_stride;
+    int const width = world->width;
+    int const height = world->height;
+    for (int y = 1; y <= height; ++y) {
+        field[y * stride] = field[y * stride + 1];
+        field[y * stride + width + 1] = field[y * stride + width];
+    }
+    memcpy(field, &field[stride], stride * sizeof(float));
+    memcpy(&field[(height + 1) * stride], &field[height * stride], stride * sizeof(float));
+    parallel_for((height + NUTRIENT_BAND_ROWS - 1) / NUTRIENT_BAND_ROWS, world_diffuse_band, world);
+    world->nutrients = world->nutrients_next;
+    world->nutrients_next = field;
+}
+
+static inline size_t world_pheromone_index(World const *world, Coord coord)
+{
+    return (size_t)(coord.y + 1) * world->pheromone_stride + coord.x + 1;
+}
+
+// Steps the pheromone field from World::pheromones into
+// World::pheromones_next, on the worker's thread. Everything is in 16 bits,
+// shifting before adding so that nothing overflows, and the bits shifted out
+// let levels that have spread thin fade to nothing.
+static void world_step_pheromones(World *world)
+{
+    uint16_t *field = world->pheromones;
+    size_t const stride = world->pheromone_stride;
+    int const width = world->width;
+    int const height = world->height;
+    for (int y = 1; y <= height; ++y) {
+        field[y * stride] = field[y * stride + 1];
+        field[y * stride + width + 1] = field[y * stride + width];
+    }
+    memcpy(field, &field[stride], stride * sizeof(uint16_t));
+    memcpy(&field[(height + 1) * stride], &field[height * stride], stride * sizeof(uint16_t));
+    for (int y = 1; y <= height; ++y) {
+        uint16_t const *row = &field[y * stride];
+        uint16_t *next = &world->pheromones_next[y * stride];
+        for (int x = 1; x <= width; x += PHEROMONE_LANES) {
+            PheromoneVec const spread = (*(PheromoneVec const *)&row[x] >> 1)
+                + (*(PheromoneVec const *)&row[x - 1] >> 3)
+                + (*(PheromoneVec const *)&row[x + 1] >> 3)
+                + (*(PheromoneVec const *)&row[x - stride] >> 3)
+                + (*(PheromoneVec const *)&row[x + stride] >> 3);
+            *(PheromoneVec *)&next[x] = spread - (spread >> PHEROMONE_DECAY_SHIFT);
+        }
+    }
+}
+
+static void *pheromone_thread(void *arg)
+{
+    PheromoneWorker *worker = arg;
+    pthread_mutex_lock(&worker->lock);
+    for (;;) {
+        while (!worker->stepping && !worker->stopping)
+            pthread_cond_wait(&worker->wake, &worker->lock);
+        if (worker->stopping)
+            break;
+        pthread_mutex_unlock(&worker->lock);
+        world_step_pheromones(worker->world);
+        pthread_mutex_lock(&worker->lock);
+        worker->stepping = false;
+        pthread_cond_broadcast(&worker->wake);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+static void pheromone_worker_start(PheromoneWorker *worker)
+{
+    pthread_mutex_lock(&worker->lock);
+    worker->stepping = true;
+    pthread_cond_broadcast(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+// Installs the step the worker made during the last tick, adds the deposits
+// made during it, and sets the worker on the next step. The cells of a tick
+// see the deposits of the ticks before it, whatever the worker's timing.
+static void world_update_pheromones(World *world)
+{
+    PheromoneWorker *worker = world->pheromone_worker;
+    pthread_mutex_lock(&worker->lock);
+    while (worker->stepping)
+        pthread_cond_wait(&worker->wake, &worker->lock);
+    pthread_mutex_unlock(&worker->lock);
+    uint16_t *const stepped = world->pheromones_next;
+    world->pheromones_next = world->pheromones;
+    world->pheromones = stepped;
+    for (size_t i = 0; i < world->deposit_count; ++i) {
+        uint16_t *level = &stepped[world->deposits[i]];
+        *level = *level > UINT16_MAX - PHEROMONE_DEPOSIT ? UINT16_MAX : *level + PHEROMONE_DEPOSIT;
+    }
+    world->deposit_count = 0;
+    pheromone_worker_start(worker);
+}
+
+static void world_deposit(World *world, Coord coord)
+{
+    if (world->deposit_count == world->deposit_capacity) {
+        world->deposit_capacity = world->deposit_capacity * 2 + 64;
+        world->deposits = realloc(world->deposits, world->deposit_capacity * sizeof(uint32_t));
+    }
+    world->deposits[world->deposit_count++] = world_pheromone_index(world, coord);
+}
+
+// Stamps the wall map into a generated grid, freeing any cells on walls.
+static void world_stamp_walls(World *world)
+{
+    for (int y = 0; y < world->height; ++y) {
+        for (int x = 0; x < world->width; ++x) {
+            Coord const coord = {x, y};
+            if (!wall_at(coord))
+                continue;
+            Slot *slot = world_slot(world, world_index(world, coord));
+            if (slot_type(*slot) == ENTITY_TYPE_CELL)
+                cell_free(world, world_slot_cell(world, *slot));
+            *slot = slot_from_wall();
+        }
+    }
+}
+
+// Generates the same world for a given seed however many threads are used.
+World *world_new(int width, int height, uint64_t seed, Params const *params)
+{
+    int const tiles_wide = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int const tiles_high = (height + TILE_SIZE - 1) / TILE_SIZE;
+    GridLayout const layout = lazy_worlds ? GRID_LAYOUT_MORTON : grid_layout;
+    size_t slot_count = (size_t)width * height;
+    if (layout == GRID_LAYOUT_MORTON)
+        slot_count = (size_t)tiles_wide * tiles_high * TILE_AREA;
+    size_t const area = (size_t)width * height;
+    size_t const cell_count = lazy_worlds ? 0 : (area + CELL_SCARCITY - 1) / CELL_SCARCITY;
+    World *world = malloc(sizeof(World));
+    *world = (World) {
+        .width = width,
+        .height = height,
+        .layout = layout,
+        .tiles_wide = tiles_wide,
+        .slot_count = slot_count,
+        .params = *params,
+        .seed = seed,
+        .rng = rng_new(seed, RNG_STREAM_WORLD),
+        .cells = huge_alloc("cells", area * sizeof(Cell)),
+        .cell_count = cell_count,
+        .genomes = cell_count ? huge_alloc("genomes", cell_count * sizeof(Genome)) : NULL,
+        .genome_count = cell_count,
+        .genome_capacity = cell_count,
+        .genome_free = GENOME_NONE,
+        .species = cell_count ? huge_alloc("species", cell_count * sizeof(Species)) : NULL,
+        .species_count = cell_count,
+        .species_capacity = cell_count,
+        .species_free = GENOME_NONE,
+        .genome_lock = PTHREAD_MUTEX_INITIALIZER,
+        .slots = huge_alloc("grid", slot_count * sizeof(Slot)),
+        .parked_near = park_cells ? calloc(
+            (size_t)((width + PARK_BLOCK_SIZE - 1) >> PARK_BLOCK_SHIFT)
+                * ((height + PARK_BLOCK_SIZE - 1) >> PARK_BLOCK_SHIFT),
+            sizeof(uint32_t)) : NULL,
+    };
+    if (timing == TIMING_EVENT)
+        world_events_init(world);
+    FoodInit init = {.world = world};
+    size_t const food_count = nutrient_field ? 0 : area / params->food_scarcity;
+    for (size_t clump = 0; clump < CLUMP_COUNT; ++clump) {
+        init.wanted[clump] = food_count / CLUMP_COUNT + (clump < food_count % CLUMP_COUNT);
+        Coord const origin = {
+            .x = random_int(&world->rng, 0, world->width),
+            .y = random_int(&world->rng, 0, world->height),
+        };
+        world->clumps[clump] = (Clump) {
+            .coord = origin,
+            .origin = origin,
+            // the radius of a disk whose free squares fit the food
+            .radius = sqrt(init.wanted[clump] * CELL_SCARCITY / (CELL_SCARCITY - 1.0) / M_PI) + 0.75,
+        };
+    }
+    if (nutrient_field) {
+        // room for the last NutrientVec of a row to read one square past it
+        world->nutrient_stride = (width + 1 + NUTRIENT_LANES + NUTRIENT_LANES - 1) & -NUTRIENT_LANES;
+        size_t const size = (height + 2) * world->nutrient_stride * sizeof(float);
+        world->nutrients = huge_alloc("nutrients", size);
+        world->nutrients_next = huge_alloc("nutrients", size);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x)
+                *world_nutrient_ref(world, (Coord){x, y}) = NUTRIENT_CAPACITY;
+        }
+    }
+    if (pheromones) {
+        world->pheromone_stride = (width + 1 + PHEROMONE_LANES + PHEROMONE_LANES - 1) & -PHEROMONE_LANES;
+        size_t const size = (height + 2) * world->pheromone_stride * sizeof(uint16_t);
+        world->pheromones = huge_alloc("pheromones", size);
+        world->pheromones_next = huge_alloc("pheromones", size);
+        world->pheromone_worker = malloc(sizeof(PheromoneWorker));
+        *world->pheromone_worker = (PheromoneWorker) {
+            .lock = PTHREAD_MUTEX_INITIALIZER,
+            .wake = PTHREAD_COND_INITIALIZER,
+            .world = world,
+        };
+        pthread_create(&world->pheromone_worker->thread, NULL, pheromone_thread, world->pheromone_worker);
+        pheromone_worker_start(world->pheromone_worker);
+    }
+    Coord ai_coord = {.x = world->width / 2, .y = world->height / 2};
+    if (lazy_worlds) {
+        world->chunk_ready = calloc(slot_count / TILE_AREA, sizeof(bool));
+        if (wall_at(ai_coord))
+            ai_coord = find_nearby_empty(ai_coord, world, &world->rng);
+        Slot *ai_slot = world_get_slot_ref(world, ai_coord);
+        if (slot_type(*ai_slot) == ENTITY_TYPE_CELL)
+            cell_free(world, world_slot_cell(world, *ai_slot));
+        *ai_slot = 0;
+        cell_new(world, NULL, NULL, world_index(world, ai_coord));
+        return world;
+    }
+
+    parallel_for((cell_count + CELL_INIT_BATCH - 1) / CELL_INIT_BATCH, world_init_cells, world);
+    for (uint32_t k = 0; world->events && k < cell_count; ++k)
+        world_schedule(world, k, 0);
+    // the batches make a genome and a species per cell, merge the genomes
+    // that are the same and then the species that behave the same
+    intern_table_reserve(&world->genome_table, "genome table", cell_count);
+    intern_table_reserve(&world->species_table, "species table", cell_count);
+    for (uint32_t k = 0; k < cell_count; ++k) {
+        Genome *genome = &world->genomes[k];
+        Species *species = &world->species[k];
+        size_t slot = intern_table_find(&world->genome_table, world->genomes, sizeof(Genome),
+            &genome->chromosome, genome->hash);
+        uint32_t same = world->genome_table.slots[slot].handle;
+        if (same == GENOME_NONE) {
+            intern_table_insert(&world->genome_table, slot, k, genome->hash);
+            slot = intern_table_find(&world->species_table, world->species, sizeof(Species),
+                &species->canonical, species->hash);
+            same = world->species_table.slots[slot].handle;
+            if (same == GENOME_NONE) {
+                intern_table_insert(&world->species_table, slot, k, species->hash);
+                continue;
+            }
+            genome->species = same;
+            ++world->species[same].cells;
+        } else {
+            genome_ref(world, same);
+            world->cells[k].genome = same;
+            genome->refs = 0;
+            genome->next_free = world->genome_free;
+            world->genome_free = k;
+        }
+        species->cells = 0;
+        species->next_free = world->species_free;
+        world->species_free = k;
+    }
+    if (wall_map) {
+        world_stamp_walls(world);
+        if (wall_at(ai_coord))
+            ai_coord = find_nearby_empty(ai_coord, world, &world->rng);
+    }
+    size_t ai_index = world_index(world, ai_coord);
+    if (*world_slot(world, ai_index))
+        cell_free(world, world_slot_cell(world, *world_slot(world, ai_index)));
+    cell_new(world, NULL, NULL, ai_index);
+
+    if (nutrient_field)
+        return world;
+    parallel_for(CLUMP_COUNT, world_init_clump, &init);
+    for (size_t clump = 0; clump < CLUMP_COUNT; ++clump) {
+        size_t placed = 0;
+        for (size_t i = 0; i < init.ranked_count[clump] && placed < init.wanted[clump]; ++i) {
+            Slot *slot = world_slot(world, (uint32_t)init.ranked[clump][i]);
+            if (!*slot) {
+                *slot = slot_from_food(clump);
+                ++placed;
+            }
+        }
+        for (; placed < init.wanted[clump]; ++placed) {
+            Coord coord = find_nearby_empty(world->clumps[clump].coord, world, &world->rng);
+            Slot *slot = world_get_slot_ref(world, coord);
+            if (*slot)
+                break;
+            *slot = slot_from_food(clump);
+        }
+        free(init.ranked[clump]);
+    }
+
+    return world;
+}
+
+// Offers the hall of fame the species still living in a world.
+void world_offer_hall_of_fame(World const *world)
+{
+    for (uint32_t handle = 0; handle < world->species_count; ++handle) {
+        if (world->species[handle].cells)
+            hall_of_fame_offer(&world->species[handle]);
+    }
+}
+
+// Frees a world, once its pheromone thread has stopped. Its
+// living species are offered to the hall of fame.
+void world_free(World *world)
+{
+    if (hall_of_fame)
+        world_offer_hall_of_fame(world);
+    PheromoneWorker *worker = world->pheromone_worker;
+    if (worker) {
+        pthread_mutex_lock(&worker->lock);
+        worker->stopping = true;
+        pthread_cond_broadcast(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+        pthread_join(worker->thread, NULL);
+        free(worker);
+    }
+    huge_free(world->cells);
+    huge_free(world->genomes);
+    huge_free(world->genome_table.slots);
+    huge_free(world->species);
+    huge_free(world->species_table.slots);
+    huge_free(world->slots);
+    huge_free(world->nutrients);
+    huge_free(world->nutrients_next);
+    huge_free(world->pheromones);
+    huge_free(world->pheromones_next);
+    free(world->chunk_ready);
+    free(world->deposits);
+    free(world->parked_near);
+    free(world->park_deaths);
+    for (size_t i = 0; world->events && i <= world->event_mask; ++i)
+        free(world->events[i].cells);
+    free(world->events);
+    free(world);
+}
+
+void draw_screen(SDL_Surface *screen, World *world)
+{
+    Uint16 cell_size = 8;
+    //Uint32 cell_color = SDL_MapRGB(screen->format, -1, -1, 0);
+    Uint32 const food_color = SDL_MapRGB(screen->format, 0, -1, 0);
+    Uint32 const no_color = SDL_MapRGB(screen->format, 0, 0, 0);
+    Uint32 const trail_color = SDL_MapRGB(screen->format, 0, 0, 160);
+    Uint32 const wall_color = SDL_MapRGB(screen->format, 96, 96, 96);
+    Uint32 nutrient_colors[16];
+    for (int i = 0; i < 16; ++i)
+        nutrient_colors[i] = SDL_MapRGB(screen->format, 0, i * 8, 0);
+    // walk the squares in storage order, whatever the layout
+    for (uint32_t index = 0; index < world->slot_count; ++index) {
+        Coord const coord = world_coord(world, index);
+        if (!coord_in_bounds(coord, world))
+            continue;
+        // don't generate lazy tiles that are off screen
+        if (coord.x * cell_size >= screen->w || coord.y * cell_size >= screen->h)
+            continue;
+        {
+            Uint32 color = no_color;
+            Slot slot = *world_get_slot_ref(world, coord);
+            switch (slot_type(slot)) {
+            case ENTITY_TYPE_NONE:
+                // darker than food so cells on the field stand out
+                if (world->nutrients)
+                    color = nutrient_colors[(int)(*world_nutrient_ref(world, coord) * 15 / NUTRIENT_CAPACITY)];
+                if (world->pheromones && world->pheromones[world_pheromone_index(world, coord)] >= PHEROMONE_SENSE)
+                    color = trail_color;
+                break;
+            case ENTITY_TYPE_FOOD:
+                color = food_color;
+                break;
+            case ENTITY_TYPE_CELL:
+                color = cell_species(world, world_slot_cell(world, slot))->color;
+                break;
+            case ENTITY_TYPE_WALL:
+                color = wall_color;
+                break;
+            default:
+                abort();
+            }
+            SDL_FillRect(
+                screen,
+                &(SDL_Rect){
+                    .x = coord.x * cell_size,
+                    .y = coord.y * cell_size,
+                    .w = cell_size,
+                    .h = cell_size},
+                color);
+        }
+    }
+}
+
+Coord facing_step(Facing const facing, Coord coord, int const steps)
+{
+    switch (facing) {
+    case FACING_NORTH:
+        coord.y -= steps;
+        break;
+    case FACING_SOUTH:
+        coord.y += steps;
+        break;
+    case FACING_WEST:
+        coord.x -= steps;
+        break;
+    case FACING_EAST:
+        coord.x += steps;
+        break;
+    default:
+        abort();
+    }
+    return coord;
+}
+
+bool coord_equal(Coord *self, Coord *other)
+{
+    return self->x == other->x && self->y == other->y;
+}
+
+// What a cell sees when facing the given square.
+static Situation world_situation(World *world, Coord coord)
+{
+    if (!coord_in_bounds(coord, world))
+        return SITUATION_WALL;
+    switch (world_sense(world, coord)) {
+    case ENTITY_TYPE_NONE:
+        if (world->pheromones && world->pheromones[world_pheromone_index(world, coord)] >= PHEROMONE_SENSE)
+            return SITUATION_TRAIL;
+        return SITUATION_EMPTY;
+    case ENTITY_TYPE_CELL:
+        return SITUATION_LIFE;
+    case ENTITY_TYPE_FOOD:
+        return SITUATION_FOOD;
+    case ENTITY_TYPE_WALL:
+        return SITUATION_WALL;
+    default:
+        abort();
+    }
+}
+
+#define PARK_STEPS_MAX (GENE_COUNT * FACING_MAX)
+
+// Parking costs a few walks of the cycle, so only cells that have already
+// stayed put this many updates are worth trying.
+#define PARK_AFTER_STEPS 8
+
+// The steps a cell takes from its state and facing while its neighbours stay
+// as they are. With nowhere to move, only the state and facing change, so the
+// steps enter a cycle within PARK_STEPS_MAX.
+typedef struct {
+    // steps before the cycle starts, and the steps in the cycle
+    int lead;
+    int period;
+    uint8_t state[PARK_STEPS_MAX];
+    uint8_t facing[PARK_STEPS_MAX];
+    // cost[n] is the score spent by the first n steps
+    int cost[PARK_STEPS_MAX + 1];
+} ParkCycle;
+
+// Fails if the cell would move off its square at some point.
+static bool park_cycle_find(Chromosome const *chromosome, int const action_costs[ACTION_MAX],
+    unsigned state, Facing facing, unsigned view, ParkCycle *cycle)
+{
+    int8_t seen[GENE_COUNT][FACING_MAX];
+    memset(seen, -1, sizeof(seen));
+    cycle->cost[0] = 0;
+    for (int step = 0;; ++step) {
+        if (seen[state][facing] >= 0) {
+            cycle->lead = seen[state][facing];
+            cycle->period = step - cycle->lead;
+            return true;
+        }
+        seen[state][facing] = step;
+        cycle->state[step] = state;
+        cycle->facing[step] = facing;
+        Response const response = chromosome->genes[state].responses[view >> 2 * facing & 3];
+        switch (response_action(response)) {
+        case ACTION_TURN_LEFT:
+            facing = facing_turn(facing, -1);
+            break;
+        case ACTION_TURN_RIGHT:
+            facing = facing_turn(facing, 1);
+            break;
+        case ACTION_ATTACK:
+            if ((view >> 2 * facing & 3) == SITUATION_LIFE)
+                return false;
+            break;
+        case ACTION_DEPOSIT:
+            return false;
+        case ACTION_MOVE_FORWARD:
+        case ACTION_MOVE_BACKWARD:
+            {
+                // entity_update moves either way onto the square behind
+                Situation const dest = view >> 2 * facing_turn(facing, 2) & 3;
+                if (dest == SITUATION_EMPTY || dest == SITUATION_FOOD)
+                    return false;
+            }
+            break;
+        default:
+            abort();
+        }
+        cycle->cost[step + 1] = cycle->cost[step] + action_costs[response_action(response)];
+        state = response_next_state(response);
+    }
+}
+
+// Returns the score spent by the first steps, and which recorded step they
+// end on.
+static long park_cycle_advance(ParkCycle const *cycle, unsigned long steps, int *at)
+{
+    int const end = cycle->lead + cycle->period;
+    if (steps < (unsigned long)end) {
+        *at = steps;
+        return cycle->cost[steps];
+    }
+    unsigned long const periods = (steps - cycle->lead) / cycle->period;
+    *at = cycle->lead + (steps - cycle->lead) % cycle->period;
+    return cycle->cost[*at] + periods * (long)(cycle->cost[end] - cycle->cost[cycle->lead]);
+}
+
+// The number of steps until the score is spent, at least one, or ULONG_MAX
+// if a period costs nothing and the cell would never starve.
+static unsigned long park_cycle_lifetime(ParkCycle const *cycle, int score)
+{
+    int const end = cycle->lead + cycle->period;
+    int const period_cost = cycle->cost[end] - cycle->cost[cycle->lead];
+    if (period_cost <= 0)
+        return ULONG_MAX;
+    unsigned long steps = 1;
+    // skip whole periods that can't reach the score
+    if (score > cycle->cost[end])
+        steps = cycle->lead + (unsigned long)((score - cycle->cost[end]) / period_cost) * cycle->period;
+    int at;
+    while (park_cycle_advance(cycle, steps, &at) < score)
+        ++steps;
+    return steps;
+}
+
+// The Situation in each direction from a square, packed two bits a facing.
+static unsigned world_view(World *world, Coord coord)
+{
+    unsigned view = 0;
+    for (Facing facing = 0; facing < FACING_MAX; ++facing)
+        view |= world_situation(world, facing_step(facing, coord, 1)) << 2 * facing;
+    return view;
+}
+
+static size_t world_block(World const *world, Coord coord)
+{
+    int const blocks_wide = (world->width + PARK_BLOCK_SIZE - 1) >> PARK_BLOCK_SHIFT;
+    return (size_t)(coord.y >> PARK_BLOCK_SHIFT) * blocks_wide + (coord.x >> PARK_BLOCK_SHIFT);
+}
+
+static void world_count_parked(World *world, Coord coord, int delta)
+{
+    for (Facing facing = 0; facing < FACING_MAX; ++facing) {
+        Coord const neighbour = facing_step(facing, coord, 1);
+        if (coord_in_bounds(neighbour, world))
+            world->parked_near[world_block(world, neighbour)] += delta;
+    }
+}
+
+static void park_death_push(World *world, ParkDeath death)
+{
+    if (world->park_death_count == world->park_death_capacity) {
+        world->park_death_capacity = world->park_death_capacity * 2 + 64;
+        world->park_deaths = realloc(world->park_deaths, world->park_death_capacity * sizeof(ParkDeath));
+    }
+    ParkDeath *heap = world->park_deaths;
+    size_t i = world->park_death_count++;
+    for (; i && heap[(i - 1) / 2].tick > death.tick; i = (i - 1) / 2)
+        heap[i] = heap[(i - 1) / 2];
+    heap[i] = death;
+}
+
+static ParkDeath park_death_pop(World *world)
+{
+    ParkDeath *heap = world->park_deaths;
+    ParkDeath const top = heap[0];
+    ParkDeath const last = heap[--world->park_death_count];
+    size_t const count = world->park_death_count;
+    size_t i = 0;
+    for (size_t child; (child = 2 * i + 1) < count; i = child) {
+        if (child + 1 < count && heap[child + 1].tick < heap[child].tick)
+            ++child;
+        if (heap[child].tick >= last.tick)
+            break;
+        heap[i] = heap[child];
+    }
+    heap[i] = last;
+    return top;
+}
+
+// The tick a parked cell will run out of score on.
+static unsigned long cell_park_death(World *world, Cell const *cell)
+{
+    ParkCycle cycle;
+    bool const parkable = park_cycle_find(cell_chromosome(world, cell), world->params.action_costs,
+        cell->state, cell->facing, cell->park_view, &cycle);
+    assert(parkable);
+    unsigned long const parked_on = world->tick - (uint16_t)(world->tick - cell->park_tick);
+    return parked_on + park_cycle_lifetime(&cycle, cell->score);
+}
+
+// Parks a cell that just stayed on its square, if it would keep turning on
+// the spot for as long as its neighbours stay the same. Lifetimes are kept
+// short enough for park_tick to tell how long the cell has been parked.
+static void cell_try_park(World *world, Cell *cell, Coord coord)
+{
+    // trails spread and fade without anything touching the squares
+    if (world->pheromones)
+        return;
+    unsigned const view = world_view(world, coord);
+    ParkCycle cycle;
+    if (!park_cycle_find(cell_chromosome(world, cell), world->params.action_costs,
+            cell->state, cell->facing, view, &cycle))
+        return;
+    unsigned long const lifetime = park_cycle_lifetime(&cycle, cell->score);
+    if (lifetime > UINT16_MAX)
+        return;
+    cell->parked = true;
+    cell->park_view = view;
+    cell->park_tick = world->tick;
+    ++world->parked_count;
+    world_count_parked(world, coord, 1);
+    park_death_push(world, (ParkDeath) {
+        .tick = world->tick + lifetime,
+        .pos = cell->pos,
+    });
+}
+
+// Charges a parked cell for the steps it missed and returns it to the sweep.
+// The tick in progress only counts if the sweep has already passed the cell,
+// otherwise the sweep updates it in its new surroundings, as it would have
+// without parking.
+static void cell_unpark(World *world, Cell *cell, Coord coord)
+{
+    ParkCycle cycle;
+    bool const parkable = park_cycle_find(cell_chromosome(world, cell), world->params.action_costs,
+        cell->state, cell->facing, cell->park_view, &cycle);
+    assert(parkable);
+    bool const passed = cell->pos < world->sweep_at;
+    int at;
+    cell->score -= park_cycle_advance(&cycle, (uint16_t)(world->tick - cell->park_tick) - !passed, &at);
+    assert(cell->score > 0);
+    cell->state = cycle.state[at];
+    cell->facing = cycle.facing[at];
+    cell->parked = false;
+    cell->park_tick = 0;
+    cell->last_update_color = passed ? world->update_color : !world->update_color;
+    --world->parked_count;
+    world_count_parked(world, coord, -1);
+}
+
+static void world_wake_near(World *world, Coord coord)
+{
+    for (Facing facing = 0; facing < FACING_MAX; ++facing) {
+        Coord const neighbour = facing_step(facing, coord, 1);
+        if (!coord_in_bounds(neighbour, world))
+            continue;
+        Slot const slot = *world_slot(world, world_index(world, neighbour));
+        if (slot_type(slot) != ENTITY_TYPE_CELL)
+            continue;
+        Cell *cell = world_slot_cell(world, slot);
+        if (cell->parked)
+            cell_unpark(world, cell, neighbour);
+    }
+}
+
+// Wakes parked cells next to a square whose contents changed.
+static inline void world_touch(World *world, Coord coord)
+{
+    if (world->parked_count && world->parked_near[world_block(world, coord)])
+        world_wake_near(world, coord);
+}
+
+// Returns the parked cells that run out of score this tick to the sweep, so
+// that they take their last step and die in sweep order.
+static void world_wake_dying(World *world)
+{
+    while (world->park_death_count && world->park_deaths[0].tick <= world->tick) {
+        ParkDeath const death = park_death_pop(world);
+        Slot const slot = *world_slot(world, death.pos);
+        if (slot_type(slot) != ENTITY_TYPE_CELL)
+            continue;
+        Cell *cell = world_slot_cell(world, slot);
+        if (!cell->parked || cell_park_death(world, cell) != death.tick)
+            continue;
+        cell_unpark(world, cell, world_coord(world, death.pos));
+    }
+}
+
+// Where food of a clump eaten on a square starts looking for a new one. Now
+// and then the clump moves. During an asynchronous sweep, when clump_moves
+// isn't NULL, other threads are reading the clumps, so the move is left in
+// clump_moves, packed into one word, for when the sweep is over.
+static Coord food_rebirth_coord(World *world, Coord coord, int clump, Rng *rng, uint64_t *clump_moves)
+{
+    switch (food_spawn) {
+    case FOOD_SPAWN_RANDOM:
+        switch (food_rebirth) {
+        case FOOD_REBIRTH_NEARBY:
+            break;
+        case FOOD_REBIRTH_SOMEWHERE:
+            coord.x = random_int(rng, 0, world->width);
+            coord.y = random_int(rng, 0, world->height);
+            break;
+        default:
+            abort();
+        }
+        break;
+    case FOOD_SPAWN_CLUMP:
+        {
+            if (rng_double(rng) < 0.05) {
+                Coord moved;
+                moved.x = random_int(rng, 0, world->width);
+                moved.y = random_int(rng, 0, world->height);
+                if (clump_moves)
+                    __atomic_store_n(&clump_moves[clump], (uint64_t)moved.x << 32 | (uint32_t)moved.y,
+                        __ATOMIC_RELAXED);
+                else
+                    world->clumps[clump].coord = moved;
+            }
+            switch (food_rebirth) {
+            case FOOD_REBIRTH_NEARBY:
+                coord = world->clumps[clump].coord;
+                break;
+            case FOOD_REBIRTH_SOMEWHERE:
+                coord = world->clumps[random_int(rng, 0, CLUMP_COUNT)].coord;
+                break;
+            default:
+                abort();
+            }
+        }
+    }
+    return coord;
+}
+
+// Returns false, leaving the food where it is, if there is nowhere else for
+// it to go.
+bool relocate_food(World *world, Coord coord)
+{
+    if (world->full_tick == world->tick + 1)
+        return false;
+    Slot *food_ref = world_get_slot_ref(world, coord);
+    int const clump = slot_food_clump(*food_ref);
+    coord = food_rebirth_coord(world, coord, clump, &world->rng, NULL);
+    // moving food is just clearing one square and tagging another
+    coord = find_nearby_empty(coord, world, &world->rng);
+    Slot *new_ref = world_get_slot_ref(world, coord);
+    if (*new_ref) {
+        world->full_tick = world->tick + 1;
+        return false;
+    }
+    *new_ref = slot_from_food(clump);
+    *food_ref = 0;
+    world_touch(world, coord);
+    return true;
+}
+
+// Looks up what a cell does next, given what it faces.
+static inline Response cell_response(World *world, Cell const *cell, Coord pos)
+{
+    Coord const faced = facing_step(cell->facing, pos, 1);
+    Situation const situation = world_situation(world, faced);
+    assert(cell->state >= 0 && cell->state < GENE_COUNT);
+    assert(situation >= 0 && situation < SITUATION_MAX);
+    return cell_chromosome(world, cell)->genes[cell->state].responses[situation];
+}
+
+// Returns the first living cell next to a cell, going clockwise from the way
+// it faces, if mating is on. Tiles that haven't been generated hold no cells
+// yet, and aren't generated for this.
+static Cell *cell_find_mate(World *world, Cell const *cell, Coord coord)
+{
+    if (mating == MATING_NONE)
+        return NULL;
+    for (int turn = 0; turn < FACING_MAX; ++turn) {
+        Coord const neighbour = facing_step(facing_turn(cell->facing, turn), coord, 1);
+        if (!coord_in_bounds(neighbour, world))
+            continue;
+        Slot const slot = *world_slot(world, world_index(world, neighbour));
+        if (slot_type(slot) != ENTITY_TYPE_CELL)
+            continue;
+        // the cell's old square is still its own during an asynchronous move,
+        // and cells that died in the sweep are only freed once it's over
+        Cell *mate = world_slot_cell(world, slot);
+        if (mate != cell && __atomic_load_n(&mate->score, __ATOMIC_RELAXED) > 0)
+            return mate;
+    }
+    return NULL;
+}
+
+// parallel_for tasks per thread of an asynchronous sweep, so that threads
+// that finish early take over the rest, and the fewest cells worth a task
+#define ASYNC_TASKS_PER_THREAD 8
+#define ASYNC_TASK_CELLS_MIN 256
+// squares eaten food tries to claim before it regrows where its eater was
+#define ASYNC_REGROW_TRIES 4
+
+typedef struct {
+    World *world;
+    // the cells due an update, those born during the sweep come after them
+    size_t count;
+    // their indices grouped by TILE_AREA run of squares, and where in that
+    // order each task starts
+    uint32_t *order;
+    size_t *task_start;
+    // cells that ran out of score
+    uint32_t *dead;
+    size_t dead_count;
+    // per clump, where it moves to once the sweep is over, see
+    // food_rebirth_coord
+    uint64_t clump_moves[CLUMP_COUNT];
+} AsyncSweep;
+
+// What a thread of an asynchronous sweep works with.
+typedef struct {
+    AsyncSweep *sweep;
+    Rng rng;
+} AsyncTask;
+
+// Puts food eaten on a square during an asynchronous sweep where
+// relocate_food would, claiming the square as a cell may be moving onto it.
+static bool food_regrow_async(World *world, AsyncTask *task, Coord coord, int clump)
+{
+    for (int tries = 0; tries < ASYNC_REGROW_TRIES; ++tries) {
+        Coord const start = food_rebirth_coord(world, coord, clump, &task->rng, task->sweep->clump_moves);
+        Coord const empty = find_nearby_empty(start, world, &task->rng);
+        Slot expected = 0;
+        if (__atomic_compare_exchange_n(world_slot(world, world_index(world, empty)), &expected,
+                slot_from_food(clump), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+// cell_new for an asynchronous sweep, returning the slot for the parent to
+// leave on the square it moved from.
+static Slot cell_divide_async(World *world, Cell const *parent, Cell const *mate, uint32_t pos, Rng *rng)
+{
+    uint32_t const index = __atomic_fetch_add(&world->cell_count, 1, __ATOMIC_RELAXED);
+    Chromosome chromosome = *cell_chromosome(world, parent);
+    if (mate)
+        chromosome_cross(&chromosome, cell_chromosome(world, mate), mating, rng);
+    chromosome_mutate(&chromosome, world->params.mutation_rate, rng);
+    uint32_t genome = parent->genome;
+    bool const changed = memcmp(&chromosome, cell_chromosome(world, parent), sizeof(chromosome));
+    uint32_t hash = 0;
+    Chromosome canonical;
+    if (changed) {
+        hash = chromosome_hash(&chromosome);
+        canonical = chromosome;
+        chromosome_canonicalize(&canonical);
+    }
+    pthread_mutex_lock(&world->genome_lock);
+    ++cell_species(world, parent)->births;
+    if (changed)
+        genome = genome_intern_hashed(world, &chromosome, hash, &canonical);
+    else
+        genome_ref(world, genome);
+    pthread_mutex_unlock(&world->genome_lock);
+    world->cells[index] = (Cell) {
+        .genome = genome,
+        .pos = pos,
+        .facing = facing_turn(parent->facing, 2),
+        .score = CELL_START_SCORE,
+        .last_update_color = parent->last_update_color,
+    };
+    return slot_from_cell(index);
+}
+
+// Credits a cell, its species and the world with score it ate. shared is set
+// during an asynchronous sweep, when other threads add to the totals too.
+static inline void cell_feed(World *world, Cell *cell, int score, bool shared)
+{
+    cell->score += score;
+    if (shared) {
+        __atomic_add_fetch(&world->eaten, score, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&cell_species(world, cell)->eaten, score, __ATOMIC_RELAXED);
+    } else {
+        world->eaten += score;
+        cell_species(world, cell)->eaten += score;
+    }
+}
+
+// Moves a cell onto the square behind it, whichever way it moves, eating any
+// food there and dividing if that takes it to the mitosis threshold. Returns
+// where the cell ends up. The square is claimed with a compare and swap, as
+// during an asynchronous sweep, when task isn't NULL, other threads may be
+// claiming it too. Only the cell's own thread moves it off its square.
+static Coord cell_move(World *world, Cell *cell, uint32_t start_index, Coord start_pos, AsyncTask *task)
+{
+    Coord const dest_coord = facing_step(cell->facing, start_pos, -1);
+    if (!coord_in_bounds(dest_coord, world))
+        return start_pos;
+    Slot *const entity = world_slot(world, start_index);
+    Slot *const dest = world_get_slot_ref(world, dest_coord);
+    Slot seen = __atomic_load_n(dest, __ATOMIC_RELAXED);
+    if (seen && slot_type(seen) != ENTITY_TYPE_FOOD)
+        return start_pos;
+    if (seen && !task) {
+        // the food moves off first, and in a full world regrows on the spot,
+        // leaving the cell where it was
+        cell_feed(world, cell, FOOD_SCORE, false);
+        if (!relocate_food(world, dest_coord))
+            return start_pos;
+        seen = 0;
+    }
+    if (!__atomic_compare_exchange_n(dest, &seen, *entity, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return start_pos;
+    // food eaten during an asynchronous sweep that finds nowhere else to go
+    // regrows where the cell was
+    Slot vacated = 0;
+    if (seen) {
+        cell_feed(world, cell, FOOD_SCORE, true);
+        if (!food_regrow_async(world, task, dest_coord, slot_food_clump(seen)))
+            vacated = seen;
+    }
+    cell->pos = world_index(world, dest_coord);
+    if (world->nutrients)
+        cell_feed(world, cell, world_harvest(world, dest_coord), task);
+    if (!vacated && cell->score >= world->params.mitosis_threshold) {
+        Cell const *mate = cell_find_mate(world, cell, dest_coord);
+        if (task) {
+            vacated = cell_divide_async(world, cell, mate, start_index, &task->rng);
+        } else {
+            Cell const *child = cell_new(world, cell, mate, start_index);
+            vacated = slot_from_cell(world_cell_index(world, child));
+        }
+        cell->score = CELL_START_SCORE;
+    }
+    __atomic_store_n(entity, vacated, __ATOMIC_RELEASE);
+    world_touch(world, start_pos);
+    world_touch(world, dest_coord);
+    return dest_coord;
+}
+
+// Carries out a cell's response to what it faces and sets *action to what it
+// did. Returns the cell, which a kill can move in the table, or NULL if it
+// ran out of score. task is NULL unless this is an asynchronous sweep, which
+// has neither predation nor parking, and frees the cells that die once it's
+// over.
+static Cell *cell_act(
+    World *const world,
+    Cell *cell,
+    uint32_t const start_index,
+    Coord const start_pos,
+    Action *const action,
+    AsyncTask *const task)
+{
+    Response const response = cell_response(world, cell, start_pos);
+    *action = response_action(response);
+    Coord pos = start_pos;
+    switch (response_action(response)) {
+    case ACTION_TURN_LEFT:
+        cell->facing = facing_turn(cell->facing, -1);
+        break;
+    case ACTION_TURN_RIGHT:
+        cell->facing = facing_turn(cell->facing, 1);
+        break;
+    case ACTION_MOVE_FORWARD:
+    case ACTION_MOVE_BACKWARD:
+        pos = cell_move(world, cell, start_index, start_pos, task);
+        break;
+    case ACTION_ATTACK:
+        {
+            Coord const faced = facing_step(cell->facing, start_pos, 1);
+            Slot const *faced_ref = world_get_slot_ref(world, faced);
+            if (!faced_ref || slot_type(*faced_ref) != ENTITY_TYPE_CELL)
+                break;
+            Cell *victim = world_slot_cell(world, *faced_ref);
+            if (victim->parked)
+                cell_unpark(world, victim, faced);
+            int const bite = victim->score < ATTACK_SCORE ? victim->score : ATTACK_SCORE;
+            victim->score -= bite;
+            cell->score += bite;
+            ++world->attacks;
+            if (victim->score > 0)
+                break;
+            ++world->kills;
+            Cell const *last = &world->cells[world->cell_count - 1];
+            cell_free(world, victim);
+            // the attacker was last in the table and took the victim's place
+            if (cell == last)
+                cell = victim;
+            world_touch(world, faced);
+        }
+        break;
+    case ACTION_DEPOSIT:
+        // room was made for a deposit per cell before an asynchronous sweep
+        if (task)
+            world->deposits[__atomic_fetch_add(&world->deposit_count, 1, __ATOMIC_RELAXED)]
+                = world_pheromone_index(world, start_pos);
+        else
+            world_deposit(world, start_pos);
+        break;
+    default:
+        abort();
+    }
+    cell->score -= world->params.action_costs[response_action(response)];
+    cell->state = response_next_state(response);
+    //assert(cell->score >= 0);
+    if (cell->score <= 0) {
+        if (task) {
+            AsyncSweep *sweep = task->sweep;
+            sweep->dead[__atomic_fetch_add(&sweep->dead_count, 1, __ATOMIC_RELAXED)] = world_cell_index(world, cell);
+            return NULL;
+        }
+        cell_free(world, cell);
+        world_touch(world, pos);
+        return NULL;
+    }
+    if (park_cells) {
+        if (cell->pos != start_index)
+            cell->park_tick = 0;
+        else if (++cell->park_tick >= PARK_AFTER_STEPS)
+            cell_try_park(world, cell, pos);
+    }
+    return cell;
+}
+
+void entity_update(
+    World *const world,
+    uint32_t const start_index,
+    Coord const start_pos,
+    int const update_color)
+{
+    Slot const *entity = world_slot(world, start_index);
+    if (slot_type(*entity) != ENTITY_TYPE_CELL)
+        return;
+    Cell *cell = world_slot_cell(world, *entity);
+    if (cell->parked || cell->last_update_color == update_color)
+        return;
+    else
+        cell->last_update_color = update_color;
+    world->sweep_at = start_index + 1;
+    Action action;
+    cell_act(world, cell, start_index, start_pos, &action, NULL);
+}
+
+static void world_sweep_async_batch(void *ctx, size_t batch)
+{
+    AsyncSweep *sweep = ctx;
+    World *world = sweep->world;
+    AsyncTask task = {
+        .sweep = sweep,
+        .rng = rng_new(splitmix64(world->seed + world->tick), RNG_STREAM_ASYNC + batch),
+    };
+    for (size_t i = sweep->task_start[batch]; i < sweep->task_start[batch + 1]; ++i) {
+        Cell *cell = &world->cells[sweep->order[i]];
+        Action action;
+        cell_act(world, cell, cell->pos, world_coord(world, cell->pos), &action, &task);
+    }
+}
+
+// Splits the cells of an asynchronous sweep into tasks by where they are on
+// the grid rather than where they are in the table, which drifts out of grid
+// order between sorts. The cells are counting sorted by TILE_AREA run of
+// squares and cut into tasks of the same number of cells, so that each task
+// keeps to a stretch of the grid and threads rarely race for the same
+// squares. Returns the number of tasks.
+static size_t world_sweep_async_split(World *world, AsyncSweep *sweep)
+{
+    size_t const count = sweep->count;
+    size_t const run_count = (world->slot_count + TILE_AREA - 1) / TILE_AREA;
+    // prefix sums of the cells in each run
+    size_t *run_start = calloc(run_count + 1, sizeof(size_t));
+    for (size_t i = 0; i < count; ++i)
+        ++run_start[(world->cells[i].pos >> (2 * TILE_SHIFT)) + 1];
+    for (size_t run = 0; run < run_count; ++run)
+        run_start[run + 1] += run_start[run];
+    for (size_t i = 0; i < count; ++i)
+        sweep->order[run_start[world->cells[i].pos >> (2 * TILE_SHIFT)]++] = i;
+    free(run_start);
+
+    size_t task_count = parallel_thread_count() * ASYNC_TASKS_PER_THREAD;
+    if (task_count > count / ASYNC_TASK_CELLS_MIN)
+        task_count = count / ASYNC_TASK_CELLS_MIN ? count / ASYNC_TASK_CELLS_MIN : 1;
+    sweep->task_start = malloc((task_count + 1) * sizeof(size_t));
+    for (size_t task = 0; task <= task_count; ++task)
+        sweep->task_start[task] = task * count / task_count;
+    return task_count;
+}
+
+// The sweep of a tick with async_update.
+static void world_sweep_async(World *world)
+{
+    size_t const count = world->cell_count;
+    AsyncSweep sweep = {
+        .world = world,
+        .count = count,
+        .order = malloc(count * sizeof(uint32_t)),
+        .dead = malloc(count * sizeof(uint32_t)),
+    };
+    memset(sweep.clump_moves, -1, sizeof(sweep.clump_moves));
+    // each cell adds at most a genome, a species and a deposit, so none of
+    // the stores move while the threads are at work
+    genome_reserve(world, count);
+    species_reserve(world, count);
+    if (world->pheromones && world->deposit_capacity < world->deposit_count + count) {
+        world->deposit_capacity = world->deposit_count + count;
+        world->deposits = realloc(world->deposits, world->deposit_capacity * sizeof(uint32_t));
+    }
+    parallel_for(world_sweep_async_split(world, &sweep), world_sweep_async_batch, &sweep);
+    free(sweep.order);
+    free(sweep.task_start);
+    for (size_t clump = 0; clump < CLUMP_COUNT; ++clump) {
+        uint64_t const moved = sweep.clump_moves[clump];
+        if (moved != UINT64_MAX)
+            world->clumps[clump].coord = (Coord) {.x = moved >> 32, .y = (uint32_t)moved};
+    }
+    // highest first, so that the last cell moved into each hole is alive
+    qsort(sweep.dead, sweep.dead_count, sizeof(uint32_t), compare_uint32);
+    for (size_t i = sweep.dead_count; i--;)
+        cell_free(world, &world->cells[sweep.dead[i]]);
+    free(sweep.dead);
+}
+
+#define RADIX_BITS 11
+
+// LSD radix sorts the cell table by square index and then repoints the grid
+// at the new indices in a single pass.
+void world_sort_cells(World *world)
+{
+    size_t const count = world->cell_count;
+    Cell *from = world->cells;
+    Cell *to = malloc(count * sizeof(Cell));
+    Cell *const scratch = to;
+    unsigned const key_bits = 32 - __builtin_clz((world->slot_count - 1) | 1);
+    for (unsigned shift = 0; shift < key_bits; shift += RADIX_BITS) {
+        size_t offsets[1 << RADIX_BITS] = {0};
+        uint32_t const mask = (1 << RADIX_BITS) - 1;
+        for (size_t i = 0; i < count; ++i)
+            ++offsets[from[i].pos >> shift & mask];
+        size_t total = 0;
+        for (size_t digit = 0; digit <= mask; ++digit) {
+            size_t const digit_count = offsets[digit];
+            offsets[digit] = total;
+            total += digit_count;
+        }
+        for (size_t i = 0; i < count; ++i)
+            to[offsets[from[i].pos >> shift & mask]++] = from[i];
+        Cell *const swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != world->cells)
+        memcpy(world->cells, from, count * sizeof(Cell));
+    free(scratch);
+    for (size_t i = 0; i < count; ++i)
+        *world_slot(world, world->cells[i].pos) = slot_from_cell(i);
+    if (world->events) {
+        // the queue has the indices from before the sort
+        for (size_t i = 0; i <= world->event_mask; ++i)
+            world->events[i].count = 0;
+        for (size_t i = 0; i < count; ++i)
+            world_schedule(world, i, cell_due(world, &world->cells[i]));
+    }
+}
+
+// Stage two of the sweep pipeline: the cell record was prefetched when the
+// square was found, so now its genome row and faced square can be fetched.
+static inline void sweep_prefetch_cell(World *world, uint32_t index)
+{
+    Slot const slot = *world_slot(world, index);
+    if (slot_type(slot) != ENTITY_TYPE_CELL)
+        return;
+    Cell const *cell = world_slot_cell(world, slot);
+    if (cell->parked)
+        return;
+    __builtin_prefetch(&world->genomes[cell->genome].chromosome.genes[cell->state]);
+    Coord const faced = facing_step(cell->facing, world_coord(world, index), 1);
+    if (coord_in_bounds(faced, world))
+        __builtin_prefetch(world_slot(world, world_index(world, faced)));
+}
+
+// Everything a tick does before the sweep.
+static void world_begin_tick(World *world, int turn_color)
+{
+    if (cell_sort_interval && !(world->tick % cell_sort_interval))
+        world_sort_cells(world);
+    if (world->nutrients)
+        world_update_nutrients(world);
+    if (world->pheromones)
+        world_update_pheromones(world);
+    ++world->tick;
+    world->update_color = turn_color;
+    world->sweep_at = 0;
+    world_wake_dying(world);
+}
+
+// The cells' part of a tick with TIMING_EVENT. Every cell due before the end
+// of the tick acts, in order of time, and is queued again for when its action
+// is done.
+static void world_run_events(World *world)
+{
+    unsigned long const end = world->tick * EVENT_TICK_COST;
+    for (; world->event_time < end; ++world->event_time) {
+        EventBucket *bucket = &world->events[world->event_time & world->event_mask];
+        // the bucket can grow as it's walked, with cells due now that were
+        // moved into holes in the table
+        for (size_t i = 0; i < bucket->count; ++i) {
+            uint32_t const index = bucket->cells[i];
+            if (index >= world->cell_count || world->cells[index].due != (uint16_t)world->event_time)
+                continue;
+            Cell *cell = &world->cells[index];
+            Action action;
+            cell = cell_act(world, cell, cell->pos, world_coord(world, cell->pos), &action, NULL);
+            if (cell) {
+                world_schedule(world, world_cell_index(world, cell),
+                    world->event_time + world_action_duration(world, action));
+            }
+        }
+        bucket->count = 0;
+    }
+}
+
+void update_world(World *world, int turn_color)
+{
+    world_begin_tick(world, turn_color);
+    if (async_update) {
+        world_sweep_async(world);
+        return;
+    }
+    if (world->events) {
+        world_run_events(world);
+        return;
+    }
+    // Walks the squares in storage order with a three stage pipeline over the
+    // cells found: prefetch the cell record when its square is found, its
+    // genome row and faced square prefetch_distance cells later, and update it
+    // after another prefetch_distance cells. Squares that were not cells when
+    // found can't hold a cell due an update by the time the sweep reaches
+    // them, as cells only move when updated.
+    uint32_t pending[2 * PREFETCH_DISTANCE_MAX];
+    size_t const mask = 2 * PREFETCH_DISTANCE_MAX - 1;
+    size_t const distance = prefetch_distance;
+    size_t found = 0;
+    size_t updated = 0;
+    for (uint32_t index = 0; index < world->slot_count; ++index) {
+        // ungenerated tiles are empty
+        if (world->chunk_ready && !(index & (TILE_AREA - 1))
+                && !world->chunk_ready[index >> (2 * TILE_SHIFT)]) {
+            index += TILE_AREA - 1;
+            continue;
+        }
+        Slot const slot = *world_slot(world, index);
+        if (slot_type(slot) != ENTITY_TYPE_CELL)
+            continue;
+        __builtin_prefetch(world_slot_cell(world, slot));
+        pending[found++ & mask] = index;
+        if (found > distance)
+            sweep_prefetch_cell(world, pending[(found - 1 - distance) & mask]);
+        if (found - updated > 2 * distance) {
+            uint32_t const next = pending[updated++ & mask];
+            entity_update(world, next, world_coord(world, next), turn_color);
+        }
+    }
+    while (updated < found) {
+        uint32_t const next = pending[updated++ & mask];
+        entity_update(world, next, world_coord(world, next), turn_color);
+    }
+    world->sweep_at = UINT32_MAX;
+}
+
+// The sweep color of a world's next tick, alternating from 1 on the first as
+// the loops that call update_world have it.
+static inline int world_next_color(World const *world)
+{
+    return !(world->tick & 1);
+}
+
+// a square of every world in a 256-bit vector
+#define BATCH_SHIFT 3
+#define BATCH_LANES (1 << BATCH_SHIFT)
+
+typedef Slot SlotVec __attribute__((vector_size(BATCH_LANES * sizeof(Slot))));
+
+// Up to BATCH_LANES worlds of the same size and layout stepped together. Each
+// world is a lane of an interleaved grid, where a square's slots for all the
+// worlds are next to each other, and gets its own grid back when the batch is
+// freed. Small worlds are mostly empty squares, which the sweep of a batch
+// skips for every world at once.
+typedef struct {
+    World *worlds[BATCH_LANES];
+    Slot *grids[BATCH_LANES];
+    int count;
+    size_t slot_count;
+    Slot *slots;
+} Batch;
+
+Batch *batch_new(World *const *worlds, int count)
+{
+    assert(count > 0 && count <= BATCH_LANES);
+    size_t const slot_count = worlds[0]->slot_count;
+    Batch *batch = malloc(sizeof(Batch));
+    *batch = (Batch) {
+        .count = count,
+        .slot_count = slot_count,
+        .slots = huge_alloc("batch grid", slot_count * BATCH_LANES * sizeof(Slot)),
+    };
+    for (int lane = 0; lane < count; ++lane) {
+        World *world = worlds[lane];
+        assert(world->width == worlds[0]->width && world->height == worlds[0]->height
+            && world->layout == worlds[0]->layout && !world->slot_shift);
+        for (size_t index = 0; index < slot_count; ++index)
+            batch->slots[index << BATCH_SHIFT | lane] = world->slots[index];
+        batch->worlds[lane] = world;
+        batch->grids[lane] = world->slots;
+        world->slots = batch->slots + lane;
+        world->slot_shift = BATCH_SHIFT;
+    }
+    return batch;
+}
+
+// Frees a batch, copying its worlds back to their own grids.
+void batch_free(Batch *batch)
+{
+    for (int lane = 0; lane < batch->count; ++lane) {
+        World *world = batch->worlds[lane];
+        Slot *grid = batch->grids[lane];
+        for (size_t index = 0; index < batch->slot_count; ++index)
+            grid[index] = *world_slot(world, index);
+        world->slots = grid;
+        world->slot_shift = 0;
+    }
+    huge_free(batch->slots);
+    free(batch);
+}
+
+static inline bool slot_vec_any(SlotVec const *v)
+{
+    Slot any = 0;
+    for (int lane = 0; lane < BATCH_LANES; ++lane)
+        any |= (*v)[lane];
+    return any;
+}
+
+// Steps the worlds of a batch that still have cells, each as update_world
+// would with world_next_color, and returns a mask of the lanes stepped. The
+// sweep walks the squares once for all of them, and only stops on those where
+// some world has a cell, which it updates just as the sweep of that world on
+// its own would.
+unsigned batch_update(Batch *batch)
+{
+    unsigned stepped = 0;
+    SlotVec live = {0};
+    for (int lane = 0; lane < batch->count; ++lane) {
+        World *world = batch->worlds[lane];
+        if (!world->cell_count)
+            continue;
+        world_begin_tick(world, world_next_color(world));
+        stepped |= 1u << lane;
+        live[lane] = -1;
+    }
+    SlotVec const *squares = (SlotVec const *)batch->slots;
+    for (uint32_t index = 0; index < batch->slot_count; ++index) {
+        SlotVec const cells = (SlotVec)(squares[index] >> SLOT_TYPE_SHIFT == ENTITY_TYPE_CELL) & live;
+        if (!slot_vec_any(&cells))
+            continue;
+        for (int lane = 0; lane < batch->count; ++lane) {
+            if (!cells[lane])
+                continue;
+            World *world = batch->worlds[lane];
+            entity_update(world, index, world_coord(world, index), world->update_color);
+        }
+    }
+    for (int lane = 0; lane < batch->count; ++lane)
+        batch->worlds[lane]->sweep_at = UINT32_MAX;
+    return stepped;
+}
+
+// Restocks a world with cells on the empty squares where it started with
+// them, in the tiles generated so far, from the hall of fame when there is
+// one and otherwise from chromosome_root.
+static void world_reseed(World *world)
+{
+    ++world->reseeds;
+    for (uint32_t index = 0; index < world->slot_count; ++index) {
+        if (world->chunk_ready && !(index & (TILE_AREA - 1))
+                && !world->chunk_ready[index >> (2 * TILE_SHIFT)]) {
+            index += TILE_AREA - 1;
+            continue;
+        }
+        Coord const coord = world_coord(world, index);
+        size_t const i = (size_t)coord.y * world->width + coord.x;
+        if (!coord_in_bounds(coord, world) || i % CELL_SCARCITY || *world_slot(world, index))
+            continue;
+        Chromosome const chromosome = hall_of_fame && hall_of_fame->count
+            ? hall_of_fame_pick(&world->rng)
+            : chromosome_root(world->params.mutation_rate, &world->rng);
+        Cell *cell = &world->cells[world->cell_count++];
+        *cell = (Cell) {
+            .genome = genome_intern(world, &chromosome),
+            .score = CELL_START_SCORE,
+            .pos = index,
+            .facing = (i / CELL_SCARCITY + 1) % FACING_MAX,
+            .last_update_color = world->update_color,
+        };
+        *world_slot(world, index) = slot_from_cell(world_cell_index(world, cell));
+        if (world->events)
+            world_schedule(world, world_cell_index(world, cell), world->event_time + 1);
+        world_touch(world, coord);
+    }
+}
+
+// Returns whether a run should go on after a tick, reseeding the world first
+// if it has fallen below the population floor and extinction says to.
+static bool world_watchdog(World *world)
+{
+    if (extinction == EXTINCTION_IGNORE || world->cell_count >= (size_t)population_floor)
+        return true;
+    if (extinction == EXTINCTION_EXIT)
+        return false;
+    world_reseed(world);
+    return true;
+}
+
+double seconds_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Exponentially weighted mean of a series, and the mean and variance of that
+// in turn. The variance is of the moving average rather than of the values,
+// so that it measures drift rather than noise from tick to tick.
+typedef struct {
+    double mean;
+    double mean_mean;
+    double variance;
+} MovingStat;
+
+static void moving_stat_start(MovingStat *stat, double value)
+{
+    stat->mean = value;
+    stat->mean_mean = value;
+}
+
+static void moving_stat_add(MovingStat *stat, double value)
+{
+    double const alpha = 1.0 / CONVERGE_WINDOW;
+    stat->mean += alpha * (value - stat->mean);
+    double const delta = stat->mean - stat->mean_mean;
+    stat->mean_mean += alpha * delta;
+    stat->variance = (1 - alpha) * (stat->variance + alpha * delta * delta);
+}
+
+// A series that has stayed at 0 has settled too.
+static bool moving_stat_settled(MovingStat const *stat)
+{
+    return sqrt(stat->variance) <= converge_cv * stat->mean;
+}
+
+// What a bench run has seen of the stopping criteria so far.
+typedef struct {
+    double start;
+    unsigned long ticks;
+    MovingStat population;
+    MovingStat eaten;
+    unsigned long last_eaten;
+    uint32_t dominant_hash;
+    unsigned long dominant_since;
+} Convergence;
+
+// Updates the statistics after a tick and returns why the run should stop, or
+// NULL to go on.
+static char const *convergence_check(Convergence *convergence, World const *world)
+{
+    unsigned long const tick = ++convergence->ticks;
+    if ((converge_cv > 0 || stable_ticks > 0) && !world->cell_count)
+        return "population extinct";
+    if (converge_cv > 0) {
+        // start from the first values rather than ramping up from zero
+        if (tick == 1) {
+            moving_stat_start(&convergence->population, world->cell_count);
+            moving_stat_start(&convergence->eaten, world->eaten);
+        }
+        moving_stat_add(&convergence->population, world->cell_count);
+        moving_stat_add(&convergence->eaten, world->eaten - convergence->last_eaten);
+        convergence->last_eaten = world->eaten;
+        if (tick >= CONVERGE_WINDOW && moving_stat_settled(&convergence->population)
+                && moving_stat_settled(&convergence->eaten))
+            return "population and feeding converged";
+    }
+    if (stable_ticks > 0 && !(tick % DOMINANT_CHECK_INTERVAL)) {
+        uint32_t dominant = GENOME_NONE;
+        for (uint32_t handle = 0; handle < world->species_count; ++handle) {
+            if (world->species[handle].cells
+                    && (dominant == GENOME_NONE || world->species[handle].cells > world->species[dominant].cells))
+                dominant = handle;
+        }
+        uint32_t const hash = dominant == GENOME_NONE ? 0 : world->species[dominant].hash;
+        if (tick == DOMINANT_CHECK_INTERVAL || hash != convergence->dominant_hash) {
+            convergence->dominant_hash = hash;
+            convergence->dominant_since = tick;
+        } else if (tick - convergence->dominant_since >= (unsigned long)stable_ticks) {
+            return "dominant species stable";
+        }
+    }
+    if (time_limit > 0 && seconds_now() - convergence->start >= time_limit)
+        return "time limit";
+    return NULL;
+}
+
+// Prints the number of species and the most populous few.
+void world_report_species(World const *world, FILE *out, size_t top_count)
+{
+    uint32_t top[top_count];
+    size_t found = 0;
+    for (uint32_t handle = 0; handle < world->species_count; ++handle) {
+        uint32_t const cells = world->species[handle].cells;
+        if (!cells)
+            continue;
+        size_t i = found < top_count ? found++ : top_count;
+        for (; i > 0 && world->species[top[i - 1]].cells < cells; --i) {
+            if (i < top_count)
+                top[i] = top[i - 1];
+        }
+        if (i < top_count)
+            top[i] = handle;
+    }
+    fprintf(out, "%zu species\n", world->species_table.count);
+    for (size_t i = 0; i < found; ++i) {
+        Species const *species = &world->species[top[i]];
+        Chromosome chromosome = species->canonical;
+        fprintf(out, "  %u cells, %d states, color #%06x\n",
+            species->cells, chromosome_canonicalize(&chromosome), species->color);
+    }
+}
+
+// Prints the size of the hall of fame and its best entry.
+void hall_of_fame_report(FILE *out)
+{
+    HallOfFame *hall = hall_of_fame;
+    pthread_mutex_lock(&hall->lock);
+    Fame const *best = NULL;
+    for (size_t i = 0; i < hall->count; ++i) {
+        if (!best || hall->entries[i].eaten > best->eaten)
+            best = &hall->entries[i];
+    }
+    fprintf(out, "hall of fame: %zu species", hall->count);
+    if (best) {
+        Chromosome chromosome = best->chromosome;
+        fprintf(out, ", best ate %lu with %lu births, %d states, color #%06x",
+            best->eaten, best->births, chromosome_canonicalize(&chromosome), chromosome_color(&chromosome));
+    }
+    fputc('\n', out);
+    pthread_mutex_unlock(&hall->lock);
+}
+
+// Generates and steps a world headless and reports how long that took, for
+// comparing engine options on worlds too large to draw. Returns the exit
+// status, EXIT_EXTINCT if the watchdog stopped the run.
+int run_bench(int width, int height, uint64_t seed, long ticks)
+{
+    double const generate_start = seconds_now();
+    World *world = world_new(width, height, seed, &params);
+    printf("generated %dx%d in %.3fs on %d threads\n",
+        width, height, seconds_now() - generate_start, parallel_thread_count());
+    int turn_color = 0;
+    double const start = seconds_now();
+    bool alive = true;
+    long const wanted = ticks;
+    Convergence convergence = {.start = start};
+    char const *stopped = NULL;
+    for (ticks = 0; ticks < wanted && alive && !stopped; ++ticks) {
+        turn_color = !turn_color;
+        update_world(world, turn_color);
+        alive = world_watchdog(world);
+        stopped = convergence_check(&convergence, world);
+    }
+    double const elapsed = seconds_now() - start;
+    printf("%s %dx%d: %ld ticks in %.3fs, %.2f ticks/s, %.2f ns/square, %zu cells, %zu parked\n",
+        grid_layout_names[world->layout], world->width, world->height,
+        ticks, elapsed, ticks / elapsed,
+        elapsed * 1e9 / ticks / ((double)world->width * world->height),
+        world->cell_count, world->parked_count);
+    if (predation)
+        printf("%lu attacks, %lu kills\n", world->attacks, world->kills);
+    if (world->reseeds)
+        printf("%lu reseeds\n", world->reseeds);
+    if (!alive)
+        printf("below %d cells after %ld ticks\n", population_floor, ticks);
+    else if (stopped)
+        printf("stopped after %ld ticks: %s\n", ticks, stopped);
+    world_report_species(world, stdout, 5);
+    if (hall_of_fame) {
+        world_offer_hall_of_fame(world);
+        hall_of_fame_report(stdout);
+    }
+    return alive ? 0 : EXIT_EXTINCT;
+}
+
+static WallMap *wall_map_new(int width, int height)
+{
+    WallMap *map = malloc(sizeof(WallMap));
+    map->width = width;
+    map->height = height;
+    map->row_words = (width + 63) / 64;
+    map->bits = calloc(map->row_words * height, sizeof(uint64_t));
+    return map;
+}
+
+static void wall_map_free(WallMap *map)
+{
+    free(map->bits);
+    free(map);
+}
+
+static void wall_map_set(WallMap *map, int x, int y)
+{
+    map->bits[(size_t)y * map->row_words + x / 64] |= (uint64_t)1 << (x % 64);
+}
+
+static bool wall_map_open_somewhere(WallMap const *map)
+{
+    for (int y = 0; y < map->height; ++y) {
+        for (int x = 0; x < map->width; ++x) {
+            if (!(map->bits[(size_t)y * map->row_words + x / 64] >> (x % 64) & 1))
+                return true;
+        }
+    }
+    return false;
+}
+
+// The next number in a PGM header, skipping whitespace and comments, or -1.
+static long pgm_number(char const **at, char const *end)
+{
+    char const *p = *at;
+    while (p < end && (*p == '#' || strchr(" \t\r\n", *p))) {
+        if (*p == '#') {
+            while (p < end && *p != '\n')
+                ++p;
+        } else {
+            ++p;
+        }
+    }
+    if (p == end || *p < '0' || *p > '9')
+        return -1;
+    long value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        value = value * 10 + (*p - '0');
+    *at = p;
+    return value;
+}
+
+static WallMap *wall_map_parse_pgm(char const *data, char const *end, char const *path)
+{
+    bool const binary = data[1] == '5';
+    char const *at = data + 2;
+    long const width = pgm_number(&at, end);
+    long const height = pgm_number(&at, end);
+    long const maxval = pgm_number(&at, end);
+    if (width <= 0 || height <= 0 || maxval <= 0 || maxval > UINT16_MAX) {
+        fprintf(stderr, "%s: bad PGM header\n", path);
+        return NULL;
+    }
+    // binary pixels start after a single whitespace character
+    if (at == end || !*at || !strchr(" \t\r\n", *at)) {
+        fprintf(stderr, "%s: bad PGM header\n", path);
+        return NULL;
+    }
+    ++at;
+    int const pixel_size = maxval > UINT8_MAX ? 2 : 1;
+    if (binary && (size_t)(end - at) < (size_t)width * height * pixel_size) {
+        fprintf(stderr, "%s: PGM data too short\n", path);
+        return NULL;
+    }
+    WallMap *map = wall_map_new(width, height);
+    for (long y = 0; y < height; ++y) {
+        for (long x = 0; x < width; ++x) {
+            long value;
+            if (binary) {
+                unsigned char const *pixel = (unsigned char const *)at;
+                value = pixel_size == 2 ? pixel[0] << 8 | pixel[1] : pixel[0];
+                at += pixel_size;
+            } else if ((value = pgm_number(&at, end)) < 0) {
+                fprintf(stderr, "%s: PGM data too short\n", path);
+                wall_map_free(map);
+                return NULL;
+            }
+            if (2 * value <= maxval)
+                wall_map_set(map, x, y);
+        }
+    }
+    return map;
+}
+
+static WallMap *wall_map_parse_text(char const *data, char const *end, char const *path)
 {
-    coord.x += random_int(-1, 2);
-    coord.y += random_int(-1, 2);
-    return coord;
+    int width = 0;
+    int height = 0;
+    for (char const *line = data; line < end; ++height) {
+        char const *eol = memchr(line, '\n', end - line);
+        if (!eol)
+            eol = end;
+        int length = eol - line;
+        if (length && line[length - 1] == '\r')
+            --length;
+        if (length > width)
+            width = length;
+        line = eol + 1;
+    }
+    if (!width) {
+        fprintf(stderr, "%s: empty wall map\n", path);
+        return NULL;
+    }
+    WallMap *map = wall_map_new(width, height);
+    int y = 0;
+    for (char const *line = data; line < end; ++y) {
+        char const *eol = memchr(line, '\n', end - line);
+        if (!eol)
+            eol = end;
+        for (int x = 0; line + x < eol; ++x) {
+            if (line[x] == '#')
+                wall_map_set(map, x, y);
+        }
+        line = eol + 1;
+    }
+    return map;
 }
 
-Coord find_nearby_empty(Coord coord, World *world)
+// Loads a wall map from a PGM (P2 or P5) or text file, or prints why not and
+// returns NULL.
+static WallMap *wall_map_load(char const *path)
 {
-    assert(coord_in_bounds(coord, world));
-    while (true) {
-        Coord new_coord = perturb_coord(coord);
-        Entity **ent_ref = world_get_entity_ref(world, new_coord);
-        if (ent_ref) {
-            coord = new_coord;
-            if (!*ent_ref) return coord;
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return NULL;
+    }
+    char *data = NULL;
+    size_t size = 0;
+    for (size_t capacity = 0;;) {
+        if (size == capacity) {
+            capacity = capacity * 2 + 4096;
+            data = realloc(data, capacity);
         }
+        size_t const read = fread(data + size, 1, capacity - size, file);
+        if (!read)
+            break;
+        size += read;
+    }
+    fclose(file);
+    WallMap *map;
+    if (size >= 2 && data[0] == 'P' && (data[1] == '2' || data[1] == '5'))
+        map = wall_map_parse_pgm(data, data + size, path);
+    else
+        map = wall_map_parse_text(data, data + size, path);
+    free(data);
+    // the player's cell needs somewhere to stand
+    if (map && !wall_map_open_somewhere(map)) {
+        fprintf(stderr, "%s: no open squares\n", path);
+        wall_map_free(map);
+        return NULL;
+    }
+    return map;
+}
+
+// best chromosomes carried over unchanged each generation
+#define GA_ELITES 2
+// chromosomes drawn at random for each parent, the best of which is picked
+#define GA_TOURNAMENT 3
+
+typedef struct {
+    int width;
+    int height;
+    // the arena of this generation, the same for every chromosome
+    uint64_t arena_seed;
+    Chromosome *population;
+    unsigned long *fitness;
+} Ga;
+
+// Gives every cell in a world the same chromosome.
+static void world_adopt(World *world, Chromosome const *chromosome)
+{
+    uint32_t const handle = genome_intern(world, chromosome);
+    for (size_t i = 0; i < world->cell_count; ++i) {
+        Cell *cell = &world->cells[i];
+        genome_ref(world, handle);
+        genome_unref(world, cell->genome);
+        cell->genome = handle;
     }
+    genome_unref(world, handle);
 }
 
-World *world_new(int width, int height)
+static World *ga_arena_new(Ga const *ga, size_t index)
 {
-    World *world = malloc(sizeof(World) + width * height * sizeof(void *));
-    *world = (World) {
+    World *arena = world_new(ga->width, ga->height, ga->arena_seed, &params);
+    world_adopt(arena, &ga->population[index]);
+    return arena;
+}
+
+static void ga_evaluate(void *ctx, size_t index)
+{
+    Ga *ga = ctx;
+    World *arena = ga_arena_new(ga, index);
+    int turn_color = 0;
+    for (long tick = 0; tick < ga_ticks && arena->cell_count; ++tick) {
+        turn_color = !turn_color;
+        update_world(arena, turn_color);
+    }
+    ga->fitness[index] = arena->eaten;
+    world_free(arena);
+}
+
+// Evaluates the chromosomes from BATCH_LANES * index in a Batch.
+static void ga_evaluate_batch(void *ctx, size_t index)
+{
+    Ga *ga = ctx;
+    size_t const first = index * BATCH_LANES;
+    int const count = ga_population - first < BATCH_LANES ? ga_population - first : BATCH_LANES;
+    World *arenas[BATCH_LANES] = {0};
+    for (int lane = 0; lane < count; ++lane)
+        arenas[lane] = ga_arena_new(ga, first + lane);
+    Batch *batch = batch_new(arenas, count);
+    for (long tick = 0; tick < ga_ticks; ++tick) {
+        if (!batch_update(batch))
+            break;
+    }
+    batch_free(batch);
+    for (int lane = 0; lane < count; ++lane) {
+        ga->fitness[first + lane] = arenas[lane]->eaten;
+        world_free(arenas[lane]);
+    }
+}
+
+static size_t ga_tournament(Ga const *ga, Rng *rng)
+{
+    size_t best = rng_int(rng, ga_population);
+    for (int round = 1; round < GA_TOURNAMENT; ++round) {
+        size_t const other = rng_int(rng, ga_population);
+        if (ga->fitness[other] > ga->fitness[best])
+            best = other;
+    }
+    return best;
+}
+
+// Runs the generational mode, reporting each generation and the best
+// chromosome of the last.
+void run_ga(int width, int height, uint64_t seed, long generations)
+{
+    Rng rng = rng_new(seed, RNG_STREAM_GA);
+    Ga ga = {
         .width = width,
         .height = height,
+        .population = malloc(ga_population * sizeof(Chromosome)),
+        .fitness = malloc(ga_population * sizeof(unsigned long)),
     };
-    for (size_t i = 0; i < world->width * world->height; ++i) {
-        Entity *entity = NULL;
-        if (!(i % CELL_SCARCITY)) {
-            entity = (Entity *)cell_new(NULL);
+    Chromosome *next = malloc(ga_population * sizeof(Chromosome));
+    // fitness in the high bits and index in the low, for ranking
+    uint64_t *ranked = malloc(ga_population * sizeof(uint64_t));
+    for (int i = 0; i < ga_population; ++i)
+        ga.population[i] = chromosome_root(params.mutation_rate, &rng);
+    for (long generation = 0;; ++generation) {
+        ga.arena_seed = splitmix64(seed + generation);
+        double const start = seconds_now();
+        if (batch_worlds)
+            parallel_for((ga_population + BATCH_LANES - 1) / BATCH_LANES, ga_evaluate_batch, &ga);
+        else
+            parallel_for(ga_population, ga_evaluate, &ga);
+        double const elapsed = seconds_now() - start;
+        double total = 0;
+        for (int i = 0; i < ga_population; ++i) {
+            ranked[i] = (uint64_t)ga.fitness[i] << 16 | i;
+            total += ga.fitness[i];
+        }
+        qsort(ranked, ga_population, sizeof(uint64_t), compare_uint64);
+        Chromosome const *best = &ga.population[ranked[ga_population - 1] & 0xffff];
+        printf("generation %ld: best %lu, mean %.1f eaten, %.1f evaluations/s\n",
+            generation, ga.fitness[best - ga.population], total / ga_population,
+            ga_population / elapsed);
+        if (generation + 1 == generations) {
+            Chromosome canonical = *best;
+            int const states = chromosome_canonicalize(&canonical);
+            printf("best: %d states, color #%06x\n", states, chromosome_color(&canonical));
+            break;
         }
-        world->entities[i] = entity;
+        for (int i = 0; i < GA_ELITES && i < ga_population; ++i)
+            next[i] = ga.population[ranked[ga_population - 1 - i] & 0xffff];
+        for (int i = GA_ELITES; i < ga_population; ++i) {
+            next[i] = ga.population[ga_tournament(&ga, &rng)];
+            Chromosome const *mate = &ga.population[ga_tournament(&ga, &rng)];
+            chromosome_cross(&next[i], mate, mating == MATING_NONE ? MATING_UNIFORM : mating, &rng);
+            chromosome_mutate(&next[i], params.mutation_rate, &rng);
+        }
+        Chromosome *const swap = ga.population;
+        ga.population = next;
+        next = swap;
     }
-    size_t ai_index = (world->height / 2) * world->width + (world->width / 2);
-    free(world->entities[ai_index]);
-    Cell *ai_cell = cell_new(NULL);
-    ai_cell->chromosome = chromosome_big_square();
-    ai_cell->facing = FACING_NORTH;
-    world->entities[ai_index] = (Entity *)ai_cell;
+    free(ranked);
+    free(next);
+    free(ga.population);
+    free(ga.fitness);
+}
 
-    for (size_t i = 0; i < CLUMP_COUNT; ++i) {
-        world->clumps[i].coord = (Coord){.x = random_int(0, world->width), .y = random_int(0, world->height)};
-    }
-    for (size_t i = 0; i < (world->width * world->height) / FOOD_SCARCITY; ++i) {
-        int clump = i % CLUMP_COUNT;
-        Food *food = food_new();
-        food->clump = clump;
-        Coord coord = find_nearby_empty(world->clumps[clump].coord, world);
-        Entity **ent_ref = world_get_entity_ref(world, coord);
-        *ent_ref = (Entity *)food;
-    }
+// how far --tune varies each param, as a factor either way
+#define TUNE_SPREAD 2.0
 
-    return world;
+typedef struct {
+    Params params;
+    // NULL once pruned
+    World *world;
+    // tune_objective over the last round
+    double score;
+} TuneCandidate;
+
+typedef struct {
+    int width;
+    int height;
+    uint64_t seed;
+    // the candidates still running, best first after each round
+    TuneCandidate **alive;
+    size_t alive_count;
+    long ticks;
+} Tune;
+
+static double tune_factor(Rng *rng)
+{
+    return pow(TUNE_SPREAD, 2 * rng_double(rng) - 1);
 }
 
-void draw_screen(SDL_Surface *screen, World const *world)
+static int tune_vary(int value, int min, Rng *rng)
 {
-    Uint16 cell_size = 8;
-    //Uint32 cell_color = SDL_MapRGB(screen->format, -1, -1, 0);
-    Uint32 const food_color = SDL_MapRGB(screen->format, 0, -1, 0);
-    Uint32 const no_color = SDL_MapRGB(screen->format, 0, 0, 0);
-    for (size_t y = 0; y < world->height; ++y) {
-        for (size_t x = 0; x < world->width; ++x) {
-            Uint32 color = no_color;
-            Entity *entity = world->entities[y * world->width + x];
-            if (entity) {
-                switch (entity->type) {
-                case ENTITY_TYPE_FOOD:
-                    color = food_color;
-                    break;
-                case ENTITY_TYPE_CELL:
-                    color = ((Cell *)entity)->color;
-                    break;
-                default:
-                    abort();
-                }
-            }
-            SDL_FillRect(
-                screen,
-                &(SDL_Rect){
-                    .x = x * cell_size,
-                    .y = y * cell_size,
-                    .w = cell_size,
-                    .h = cell_size},
-                color);
-        }
+    int const varied = lround(value * tune_factor(rng));
+    return varied < min ? min : varied;
+}
+
+// A random variation on some params, each scaled by up to TUNE_SPREAD either
+// way. Food stays scarcer than one object in two squares, so that clumps can
+// always be filled, and every action costs something.
+static Params params_vary(Params const *base, Rng *rng)
+{
+    Params varied = *base;
+    varied.mutation_rate = fmin(base->mutation_rate * tune_factor(rng), 1);
+    varied.food_scarcity = tune_vary(base->food_scarcity, 2, rng);
+    varied.mitosis_threshold = tune_vary(base->mitosis_threshold, 1, rng);
+    for (int action = 0; action < ACTION_MAX; ++action)
+        varied.action_costs[action] = tune_vary(base->action_costs[action], 1, rng);
+    return varied;
+}
+
+// Prints params as the options that set them.
+static void params_print(FILE *out, Params const *params)
+{
+    fprintf(out, "--mutation-rate %.4g --food-scarcity %d --mitosis-threshold %d --action-costs ",
+        params->mutation_rate, params->food_scarcity, params->mitosis_threshold);
+    for (int action = 0; action < ACTION_MAX; ++action)
+        fprintf(out, "%d%c", params->action_costs[action], action + 1 < ACTION_MAX ? ',' : '\n');
+}
+
+static bool params_parse_costs(char const *arg, Params *params)
+{
+    for (int action = 0; action < ACTION_MAX; ++action) {
+        char *end;
+        long const cost = strtol(arg, &end, 10);
+        if (end == arg || cost < 1 || cost > INT_MAX
+                || *end != (action + 1 < ACTION_MAX ? ',' : '\0'))
+            return false;
+        params->action_costs[action] = cost;
+        arg = end + 1;
     }
+    return true;
 }
 
-Coord facing_step(Facing const facing, Coord coord, int const steps)
+static void tune_start(void *ctx, size_t index)
 {
-    switch (facing) {
-    case FACING_NORTH:
-        coord.y -= steps;
-        break;
-    case FACING_SOUTH:
-        coord.y += steps;
-        break;
-    case FACING_WEST:
-        coord.x -= steps;
-        break;
-    case FACING_EAST:
-        coord.x += steps;
-        break;
+    Tune *tune = ctx;
+    TuneCandidate *candidate = tune->alive[index];
+    candidate->world = world_new(tune->width, tune->height, tune->seed, &candidate->params);
+}
+
+// What a world adds to the total of tune_objective for a tick.
+static double tune_sample(World const *world)
+{
+    switch (tune_objective) {
+    case TUNE_OBJECTIVE_CELLS:
+        return world->cell_count;
+    case TUNE_OBJECTIVE_SPECIES:
+        return world->species_table.count;
     default:
-        abort();
+        return 0;
     }
-    return coord;
 }
 
-bool coord_equal(Coord *self, Coord *other)
+static void tune_score(TuneCandidate *candidate, unsigned long eaten, double total, long ticks)
 {
-    return self->x == other->x && self->y == other->y;
+    if (tune_objective == TUNE_OBJECTIVE_EATEN)
+        total = candidate->world->eaten - eaten;
+    candidate->score = total / ticks;
 }
 
-void relocate_food(World *world, Coord coord)
+static void tune_step(void *ctx, size_t index)
 {
-    Entity **food_ref = world_get_entity_ref(world, coord);
-    assert((*food_ref)->type == ENTITY_TYPE_FOOD);
-    switch (food_spawn) {
-    case FOOD_SPAWN_RANDOM:
-        switch (food_rebirth) {
-        case FOOD_REBIRTH_NEARBY:
-            break;
-        case FOOD_REBIRTH_SOMEWHERE:
-            coord.x = random_int(0, world->width);
-            coord.y = random_int(0, world->height);
+    Tune *tune = ctx;
+    TuneCandidate *candidate = tune->alive[index];
+    World *world = candidate->world;
+    unsigned long const eaten = world->eaten;
+    double total = 0;
+    // an extinct world scores nothing for the rest of the round
+    for (long tick = 0; tick < tune->ticks && world->cell_count; ++tick) {
+        update_world(world, world_next_color(world));
+        total += tune_sample(world);
+    }
+    tune_score(candidate, eaten, total, tune->ticks);
+}
+
+// Steps the candidates from BATCH_LANES * index in a Batch.
+static void tune_step_batch(void *ctx, size_t index)
+{
+    Tune *tune = ctx;
+    TuneCandidate **candidates = &tune->alive[index * BATCH_LANES];
+    size_t const left = tune->alive_count - index * BATCH_LANES;
+    int const count = left < BATCH_LANES ? left : BATCH_LANES;
+    World *worlds[BATCH_LANES] = {0};
+    unsigned long eaten[BATCH_LANES];
+    double total[BATCH_LANES] = {0};
+    for (int lane = 0; lane < count; ++lane) {
+        worlds[lane] = candidates[lane]->world;
+        eaten[lane] = worlds[lane]->eaten;
+    }
+    Batch *batch = batch_new(worlds, count);
+    for (long tick = 0; tick < tune->ticks; ++tick) {
+        unsigned const stepped = batch_update(batch);
+        if (!stepped)
             break;
-        default:
-            abort();
-        }
-        break;
-    case FOOD_SPAWN_CLUMP:
-        {
-            int clump = ((Food *)*food_ref)->clump;
-            if (drand48() < 0.05) {
-                Coord *clump_coord = &world->clumps[clump].coord;
-                clump_coord->x = random_int(0, world->width);
-                clump_coord->y = random_int(0, world->height);
-            }
-            switch (food_rebirth) {
-            case FOOD_REBIRTH_NEARBY:
-                coord = world->clumps[clump].coord;
-                break;
-            case FOOD_REBIRTH_SOMEWHERE:
-                coord = world->clumps[random_int(0, CLUMP_COUNT)].coord;
-                break;
-            default:
-                abort();
-            }
+        for (int lane = 0; lane < count; ++lane) {
+            if (stepped >> lane & 1)
+                total[lane] += tune_sample(worlds[lane]);
         }
     }
-    while (true) {
-        coord = find_nearby_empty(coord, world);
-        Entity **new_ref = world_get_entity_ref(world, coord);
-        assert(!*new_ref);
-        *new_ref = (Entity *)*food_ref;
-        *food_ref = NULL;
-        return;
-    }
-    assert(false);
-    // we weren't able to place the food, so destroy it in its current location
-    free(*food_ref);
-    *food_ref = NULL;
+    batch_free(batch);
+    for (int lane = 0; lane < count; ++lane)
+        tune_score(candidates[lane], eaten[lane], total[lane], tune->ticks);
 }
 
-void entity_update(
-    World *const world,
-    Coord const start_pos,
-    int const update_color)
+// best first, ties in the order the candidates were made
+static int compare_tune_candidates(void const *a, void const *b)
 {
-    Entity **entity = &world->entities[start_pos.y * world->width + start_pos.x];
-    if (!*entity)
-        return;
-    if ((*entity)->last_update_color == update_color)
-        return;
-    else
-        (*entity)->last_update_color = update_color;
-    if ((*entity)->type != ENTITY_TYPE_CELL)
-        return;
-    Cell *cell = (Cell *)*entity;
-    Situation situation = SITUATION_EMPTY;
-    Coord const faced_coord = facing_step(cell->facing, start_pos, 1);
-    Entity **faced_entity = NULL;
-    if (    faced_coord.x < 0 || faced_coord.x >= world->width
-            || faced_coord.y < 0 || faced_coord.y >= world->height) {
-        situation = SITUATION_WALL;
-    } else {
-        faced_entity = world_get_entity_ref(world, faced_coord);
-        if (*faced_entity) {
-            switch ((*faced_entity)->type) {
-            case ENTITY_TYPE_CELL:
-                situation = SITUATION_LIFE;
-                break;
-            case ENTITY_TYPE_FOOD:
-                situation = SITUATION_FOOD;
-                break;
-            default:
-                abort();
-            }
-        } else {
-            situation = SITUATION_EMPTY;
-        }
+    TuneCandidate const *x = *(TuneCandidate *const *)a;
+    TuneCandidate const *y = *(TuneCandidate *const *)b;
+    if (x->score != y->score)
+        return x->score < y->score ? 1 : -1;
+    return (x > y) - (x < y);
+}
+
+// Runs the tuning mode over count candidates, the first of them the
+// configured params, reporting each round and the params of the best
+// candidate of the last.
+void run_tune(int width, int height, uint64_t seed, int count)
+{
+    Rng rng = rng_new(seed, RNG_STREAM_TUNE);
+    TuneCandidate *candidates = malloc(count * sizeof(TuneCandidate));
+    Tune tune = {
+        .width = width,
+        .height = height,
+        .seed = seed,
+        .alive = malloc(count * sizeof(TuneCandidate *)),
+        .alive_count = count,
+        .ticks = tune_ticks,
+    };
+    for (int i = 0; i < count; ++i) {
+        candidates[i] = (TuneCandidate) {
+            .params = i ? params_vary(&params, &rng) : params,
+        };
+        tune.alive[i] = &candidates[i];
     }
-    assert(cell->state >= 0 && cell->state < GENE_COUNT);
-    assert(situation >= 0 && situation < SITUATION_MAX);
-    Response response = cell->chromosome.genes[cell->state].responses[situation];
-    switch (response.action) {
-    case ACTION_TURN_LEFT:
-        cell->facing = facing_turn(cell->facing, -1);
-        break;
-    case ACTION_TURN_RIGHT:
-        cell->facing = facing_turn(cell->facing, 1);
-        break;
-    case ACTION_MOVE_FORWARD:
-    case ACTION_MOVE_BACKWARD:
-        {
-            Coord dest_coord = facing_step(
-                cell->facing,
-                start_pos,
-                (ACTION_MOVE_FORWARD ? 1 : -1));
-            if (!coord_in_bounds(dest_coord, world))
-                break;
-            Entity **dest_ent_ptr = &world->entities[dest_coord.y * world->width + dest_coord.x];
-            if (*dest_ent_ptr) {
-                if ((*dest_ent_ptr)->type == ENTITY_TYPE_FOOD) {
-                    cell->score += FOOD_SCORE;
-                    relocate_food(world, dest_coord);
-                } else {
-                    break;
-                }
-            }
-            assert(!*dest_ent_ptr);
-            *dest_ent_ptr = (Entity *)cell;
-            *entity = NULL;
-            if (cell->score >= CELL_MITOSIS_THRESHOLD) {
-                *entity = (Entity *)cell_new(cell);
-                cell->score = CELL_START_SCORE;
-            }
-            entity = dest_ent_ptr;
+    parallel_for(count, tune_start, &tune);
+    for (int round = 0;; ++round) {
+        size_t const alive = tune.alive_count;
+        double const start = seconds_now();
+        if (batch_worlds)
+            parallel_for((alive + BATCH_LANES - 1) / BATCH_LANES, tune_step_batch, &tune);
+        else
+            parallel_for(alive, tune_step, &tune);
+        double const elapsed = seconds_now() - start;
+        qsort(tune.alive, alive, sizeof(TuneCandidate *), compare_tune_candidates);
+        printf("round %d: %zu candidates for %ld ticks, best %.2f, median %.2f %s, %.0f ticks/s\n",
+            round, alive, tune.ticks, tune.alive[0]->score, tune.alive[alive / 2]->score,
+            tune_objective_names[tune_objective], alive * tune.ticks / elapsed);
+        if (alive <= 2)
+            break;
+        size_t const kept = (alive + 1) / 2;
+        for (size_t i = kept; i < alive; ++i) {
+            world_free(tune.alive[i]->world);
+            tune.alive[i]->world = NULL;
         }
-        break;
-    default:
-        abort();
-    }
-    cell->score -= action_costs[response.action];
-    cell->state = response.next_state;
-    //assert(cell->score >= 0);
-    if (cell->score <= 0) {
-        free(*entity);
-        *entity = NULL;
+        tune.alive_count = kept;
+        tune.ticks *= 2;
     }
+    TuneCandidate const *best = tune.alive[0];
+    printf("best: candidate %td%s\n", best - candidates, best == candidates ? ", the configured params" : "");
+    params_print(stdout, &best->params);
+    for (size_t i = 0; i < tune.alive_count; ++i)
+        world_free(tune.alive[i]->world);
+    free(tune.alive);
+    free(candidates);
 }
 
-void update_world(World *world, int turn_color)
+static void usage(char const *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --width N, --height N   world size in squares (default 80x60)\n"
+        "  --layout NAME           grid layout: row-major or morton\n"
+        "  --sort-interval TICKS   ticks between cell table sorts, 0 for never\n"
+        "  --prefetch CELLS        sweep prefetch distance, 0 to %d\n"
+        "  --no-huge-pages         back world allocations with normal pages\n"
+        "  --page-report           print the page backing of world allocations\n"
+        "  --seed N                random seed (default: time)\n"
+        "  --threads N             worker threads (default: one per CPU)\n"
+        "  --lazy                  generate tiles on first access (implies morton)\n"
+        "  --park                  skip cells turning on the spot until woken\n"
+        "  --async                 update cells from all threads at once, in no\n"
+        "                          repeatable order\n"
+        "  --timing MODEL          tick: an action a tick, or event: actions take\n"
+        "                          as long as they cost, %d to a tick\n"
+        "  --mating MODE           cross offspring with a neighbour: none, uniform\n"
+        "                          or one-point\n"
+        "  --predation             let mutation evolve attacks on other cells\n"
+        "  --nutrients             graze a regrowing nutrient field instead of food\n"
+        "  --pheromones            let cells lay and follow fading trails\n"
+        "  --walls FILE            obstacle map, a PGM with dark walls or text with\n"
+        "                          '#' walls, repeated across larger worlds\n"
+        "  --bench TICKS           run headless for TICKS ticks and report speed\n"
+        "  --ga GENERATIONS        evolve chromosomes in arenas of the world size\n"
+        "  --ga-population N       chromosomes per generation (default 64)\n"
+        "  --ga-ticks TICKS        ticks each arena is run for (default 500)\n"
+        "  --hall-of-fame FILE     keep the best genomes, appending them to FILE\n"
+        "  --reseed                start worlds from the genomes in the hall of fame\n"
+        "  --extinction ACTION     below the population floor: ignore, reseed, or\n"
+        "                          exit with status %d\n"
+        "  --population-floor N    fewest cells before extinction acts (default 1)\n"
+        "  --converge CV           stop a bench once the moving averages of cells\n"
+        "                          and feeding drift by at most CV of themselves\n"
+        "  --stable-ticks TICKS    stop a bench once the top species has held TICKS\n"
+        "  --time-limit SECONDS    stop a bench after SECONDS\n"
+        "  --mutation-rate P       chance of each response part mutating (default 0.03)\n"
+        "  --food-scarcity N       squares per food object (default 11)\n"
+        "  --mitosis-threshold N   score at which cells divide (default 1000)\n"
+        "  --action-costs LIST     %d comma separated costs: forward, left, right,\n"
+        "                          backward, attack, deposit (default 8,3,3,5,5,2)\n"
+        "  --tune CANDIDATES       search the params above by successive halving\n"
+        "  --tune-ticks TICKS      ticks of the first round (default 200)\n"
+        "  --tune-objective NAME   eaten, cells or species, per tick\n"
+        "  --batch                 scan --ga and --tune worlds %d at a time\n",
+        argv0, PREFETCH_DISTANCE_MAX, EVENT_TICK_COST, EXIT_EXTINCT, ACTION_MAX, BATCH_LANES);
+}
+
+static bool parse_enum(char const *arg, char const *const names[], int count, int *value)
 {
-    for (size_t y = 0; y < world->height; ++y) {
-        for (size_t x = 0; x < world->width; ++x) {
-            entity_update(world, (Coord){.x = x, .y = y}, turn_color);
+    for (int i = 0; i < count; ++i) {
+        if (!strcmp(arg, names[i])) {
+            *value = i;
+            return true;
         }
     }
+    return false;
 }
 
 int main(int argc, char **argv)
 {
+    enum {
+        OPT_WIDTH = 256,
+        OPT_HEIGHT,
+        OPT_LAYOUT,
+        OPT_SORT_INTERVAL,
+        OPT_PREFETCH,
+        OPT_NO_HUGE_PAGES,
+        OPT_PAGE_REPORT,
+        OPT_SEED,
+        OPT_THREADS,
+        OPT_LAZY,
+        OPT_PARK,
+        OPT_ASYNC,
+        OPT_TIMING,
+        OPT_MATING,
+        OPT_PREDATION,
+        OPT_NUTRIENTS,
+        OPT_PHEROMONES,
+        OPT_WALLS,
+        OPT_BENCH,
+        OPT_GA,
+        OPT_GA_POPULATION,
+        OPT_GA_TICKS,
+        OPT_HALL_OF_FAME,
+        OPT_RESEED,
+        OPT_EXTINCTION,
+        OPT_POPULATION_FLOOR,
+        OPT_CONVERGE,
+        OPT_STABLE_TICKS,
+        OPT_TIME_LIMIT,
+        OPT_MUTATION_RATE,
+        OPT_FOOD_SCARCITY,
+        OPT_MITOSIS_THRESHOLD,
+        OPT_ACTION_COSTS,
+        OPT_TUNE,
+        OPT_TUNE_TICKS,
+        OPT_TUNE_OBJECTIVE,
+        OPT_BATCH,
+    };
+    static struct option const options[] = {
+        {"width", required_argument, NULL, OPT_WIDTH},
+        {"height", required_argument, NULL, OPT_HEIGHT},
+        {"layout", required_argument, NULL, OPT_LAYOUT},
+        {"sort-interval", required_argument, NULL, OPT_SORT_INTERVAL},
+        {"prefetch", required_argument, NULL, OPT_PREFETCH},
+        {"no-huge-pages", no_argument, NULL, OPT_NO_HUGE_PAGES},
+        {"page-report", no_argument, NULL, OPT_PAGE_REPORT},
+        {"seed", required_argument, NULL, OPT_SEED},
+        {"threads", required_argument, NULL, OPT_THREADS},
+        {"lazy", no_argument, NULL, OPT_LAZY},
+        {"park", no_argument, NULL, OPT_PARK},
+        {"async", no_argument, NULL, OPT_ASYNC},
+        {"timing", required_argument, NULL, OPT_TIMING},
+        {"mating", required_argument, NULL, OPT_MATING},
+        {"predation", no_argument, NULL, OPT_PREDATION},
+        {"nutrients", no_argument, NULL, OPT_NUTRIENTS},
+        {"pheromones", no_argument, NULL, OPT_PHEROMONES},
+        {"walls", required_argument, NULL, OPT_WALLS},
+        {"bench", required_argument, NULL, OPT_BENCH},
+        {"ga", required_argument, NULL, OPT_GA},
+        {"ga-population", required_argument, NULL, OPT_GA_POPULATION},
+        {"ga-ticks", required_argument, NULL, OPT_GA_TICKS},
+        {"hall-of-fame", required_argument, NULL, OPT_HALL_OF_FAME},
+        {"reseed", no_argument, NULL, OPT_RESEED},
+        {"extinction", required_argument, NULL, OPT_EXTINCTION},
+        {"population-floor", required_argument, NULL, OPT_POPULATION_FLOOR},
+        {"converge", required_argument, NULL, OPT_CONVERGE},
+        {"stable-ticks", required_argument, NULL, OPT_STABLE_TICKS},
+        {"time-limit", required_argument, NULL, OPT_TIME_LIMIT},
+        {"mutation-rate", required_argument, NULL, OPT_MUTATION_RATE},
+        {"food-scarcity", required_argument, NULL, OPT_FOOD_SCARCITY},
+        {"mitosis-threshold", required_argument, NULL, OPT_MITOSIS_THRESHOLD},
+        {"action-costs", required_argument, NULL, OPT_ACTION_COSTS},
+        {"tune", required_argument, NULL, OPT_TUNE},
+        {"tune-ticks", required_argument, NULL, OPT_TUNE_TICKS},
+        {"tune-objective", required_argument, NULL, OPT_TUNE_OBJECTIVE},
+        {"batch", no_argument, NULL, OPT_BATCH},
+        {"help", no_argument, NULL, 'h'},
+        {},
+    };
+    int width = 80;
+    int height = 60;
+    long seed = time(NULL);
+    long bench_ticks = 0;
+    long ga_generations = 0;
+    int tune_candidates = 0;
+    bool page_report = false;
+    for (int opt; (opt = getopt_long(argc, argv, "h", options, NULL)) != -1;) {
+        switch (opt) {
+        case OPT_WIDTH:
+            width = atoi(optarg);
+            break;
+        case OPT_HEIGHT:
+            height = atoi(optarg);
+            break;
+        case OPT_LAYOUT:
+            {
+                int layout;
+                if (!parse_enum(optarg, grid_layout_names, 2, &layout)) {
+                    fprintf(stderr, "unknown layout: %s\n", optarg);
+                    return 2;
+                }
+                grid_layout = layout;
+            }
+            break;
+        case OPT_SORT_INTERVAL:
+            cell_sort_interval = atoi(optarg);
+            break;
+        case OPT_PREFETCH:
+            prefetch_distance = atoi(optarg);
+            if (prefetch_distance < 0 || prefetch_distance > PREFETCH_DISTANCE_MAX) {
+                fprintf(stderr, "prefetch distance must be 0 to %d\n", PREFETCH_DISTANCE_MAX);
+                return 2;
+            }
+            break;
+        case OPT_NO_HUGE_PAGES:
+            huge_pages = false;
+            break;
+        case OPT_PAGE_REPORT:
+            page_report = true;
+            break;
+        case OPT_SEED:
+            seed = atol(optarg);
+            break;
+        case OPT_THREADS:
+            thread_count = atoi(optarg);
+            break;
+        case OPT_LAZY:
+            lazy_worlds = true;
+            break;
+        case OPT_PARK:
+            park_cells = true;
+            break;
+        case OPT_ASYNC:
+            async_update = true;
+            break;
+        case OPT_TIMING:
+            {
+                int model;
+                if (!parse_enum(optarg, timing_names, 2, &model)) {
+                    fprintf(stderr, "unknown timing model: %s\n", optarg);
+                    return 2;
+                }
+                timing = model;
+            }
+            break;
+        case OPT_MATING:
+            {
+                int mode;
+                if (!parse_enum(optarg, mating_names, 3, &mode)) {
+                    fprintf(stderr, "unknown mating mode: %s\n", optarg);
+                    return 2;
+                }
+                mating = mode;
+            }
+            break;
+        case OPT_PREDATION:
+            predation = true;
+            break;
+        case OPT_NUTRIENTS:
+            nutrient_field = true;
+            break;
+        case OPT_PHEROMONES:
+            pheromones = true;
+            break;
+        case OPT_WALLS:
+            wall_map = wall_map_load(optarg);
+            if (!wall_map)
+                return 2;
+            break;
+        case OPT_BENCH:
+            bench_ticks = atol(optarg);
+            break;
+        case OPT_GA:
+            ga_generations = atol(optarg);
+            break;
+        case OPT_GA_POPULATION:
+            ga_population = atoi(optarg);
+            if (ga_population < 1 || ga_population > UINT16_MAX) {
+                fprintf(stderr, "GA population must be 1 to %d\n", UINT16_MAX);
+                return 2;
+            }
+            break;
+        case OPT_GA_TICKS:
+            ga_ticks = atol(optarg);
+            break;
+        case OPT_HALL_OF_FAME:
+            hall_of_fame = hall_of_fame_open(optarg);
+            if (!hall_of_fame)
+                return 2;
+            break;
+        case OPT_RESEED:
+            hall_of_fame_reseed = true;
+            break;
+        case OPT_EXTINCTION:
+            {
+                int action;
+                if (!parse_enum(optarg, extinction_names, 3, &action)) {
+                    fprintf(stderr, "unknown extinction action: %s\n", optarg);
+                    return 2;
+                }
+                extinction = action;
+            }
+            break;
+        case OPT_POPULATION_FLOOR:
+            population_floor = atoi(optarg);
+            break;
+        case OPT_CONVERGE:
+            converge_cv = atof(optarg);
+            break;
+        case OPT_STABLE_TICKS:
+            stable_ticks = atol(optarg);
+            break;
+        case OPT_TIME_LIMIT:
+            time_limit = atof(optarg);
+            break;
+        case OPT_MUTATION_RATE:
+            params.mutation_rate = atof(optarg);
+            if (!(params.mutation_rate >= 0 && params.mutation_rate <= 1)) {
+                fprintf(stderr, "mutation rate must be from 0 to 1\n");
+                return 2;
+            }
+            break;
+        case OPT_FOOD_SCARCITY:
+            params.food_scarcity = atoi(optarg);
+            if (params.food_scarcity < 2) {
+                fprintf(stderr, "food scarcity must be at least 2\n");
+                return 2;
+            }
+            break;
+        case OPT_MITOSIS_THRESHOLD:
+            params.mitosis_threshold = atoi(optarg);
+            if (params.mitosis_threshold < 1) {
+                fprintf(stderr, "mitosis threshold must be at least 1\n");
+                return 2;
+            }
+            break;
+        case OPT_ACTION_COSTS:
+            if (!params_parse_costs(optarg, &params)) {
+                fprintf(stderr, "--action-costs needs %d comma separated costs of at least 1\n", ACTION_MAX);
+                return 2;
+            }
+            break;
+        case OPT_TUNE:
+            tune_candidates = atoi(optarg);
+            break;
+        case OPT_TUNE_TICKS:
+            tune_ticks = atol(optarg);
+            if (tune_ticks < 1) {
+                fprintf(stderr, "tuning rounds need at least a tick\n");
+                return 2;
+            }
+            break;
+        case OPT_TUNE_OBJECTIVE:
+            {
+                int objective;
+                if (!parse_enum(optarg, tune_objective_names, 3, &objective)) {
+                    fprintf(stderr, "unknown tuning objective: %s\n", optarg);
+                    return 2;
+                }
+                tune_objective = objective;
+            }
+            break;
+        case OPT_BATCH:
+            batch_worlds = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (width <= 0 || height <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (async_update && (lazy_worlds || park_cells || predation)) {
+        fprintf(stderr, "--async can't be combined with --lazy, --park or --predation\n");
+        return 2;
+    }
+    if (async_update && (tune_candidates > 0 || ga_generations > 0)) {
+        fprintf(stderr, "--async is for --bench and interactive runs\n");
+        return 2;
+    }
+    if (timing == TIMING_EVENT && (park_cells || async_update || batch_worlds)) {
+        fprintf(stderr, "--timing event can't be combined with --park, --async or --batch\n");
+        return 2;
+    }
+    if (hall_of_fame_reseed && !hall_of_fame) {
+        fprintf(stderr, "--reseed needs --hall-of-fame\n");
+        return 2;
+    }
+    if (tune_candidates > 0) {
+        if (ga_generations > 0) {
+            fprintf(stderr, "--tune and --ga can't be combined\n");
+            return 2;
+        }
+        run_tune(width, height, seed, tune_candidates);
+        if (hall_of_fame)
+            hall_of_fame_report(stdout);
+        return 0;
+    }
+    if (ga_generations > 0) {
+        if (lazy_worlds) {
+            fprintf(stderr, "--ga arenas can't be lazy, as every cell must start with the same chromosome\n");
+            return 2;
+        }
+        run_ga(width, height, seed, ga_generations);
+        if (hall_of_fame)
+            hall_of_fame_report(stdout);
+        return 0;
+    }
+    if (bench_ticks > 0) {
+        int const status = run_bench(width, height, seed, bench_ticks);
+        if (page_report)
+            huge_alloc_report(stderr);
+        return status;
+    }
     SDL_Init(SDL_INIT_VIDEO);
     SDL_Surface *screen = SDL_SetVideoMode(640, 480, 0, 0);
-    srand48(time(NULL));
-    World *world = world_new(80, 60);
+    World *world = world_new(width, height, seed, &params);
+    if (page_report)
+        huge_alloc_report(stderr);
     Uint32 last_ticks = SDL_GetTicks();
     int turn_color = 0;
     bool quit = false;
+    int status = 0;
     while (!quit) {
         turn_color = !turn_color;
         draw_screen(screen, world);
@@ -530,6 +4479,10 @@ int main(int argc, char **argv)
             }
         }
         update_world(world, turn_color);
+        if (!world_watchdog(world)) {
+            status = EXIT_EXTINCT;
+            break;
+        }
         Uint32 ticks = SDL_GetTicks();
         Uint32 next_ticks = last_ticks + FRAME_INTERVAL;
         if (ticks <= next_ticks)
@@ -538,6 +4491,7 @@ int main(int argc, char **argv)
             next_ticks = ticks;
         last_ticks = next_ticks;
     }
+    world_free(world);
     SDL_Quit();
-    return 0;
+    return status;
 }